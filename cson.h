@@ -28,10 +28,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <float.h>
 #include <ctype.h>
 #include <sys/stat.h>
 
@@ -57,10 +59,24 @@
 #endif // CSON_SHARED
 
 #define CSON_DEF_ARRAY_CAPACITY   16
-#define CSON_ARRAY_MUL_F           2
 #define CSON_MAP_CAPACITY         16
+#define CSON_MAP_MAX_LOAD         75
 #define CSON_DEF_INDENT            4
 #define CSON_REGION_CAPACITY  2*1024
+#define CSON_INDEX_WINDOW    64*1024
+#define CSON_FREE_CLASSES         64
+#define CSON_INTERN_CAPACITY 64*1024
+#define CSON_INTERN_MAX_LEN       64
+#define CSON_SMALL_STRING         16
+#ifndef CSON_MAX_DEPTH
+    #define CSON_MAX_DEPTH      1024
+#endif // CSON_MAX_DEPTH
+
+#if defined(_MSC_VER)
+    #define CSON_THREAD_LOCAL __declspec(thread)
+#else
+    #define CSON_THREAD_LOCAL _Thread_local
+#endif
 
 #define cson_ansi_rgb(r, g, b) ("\e[38;2;" #r ";" #g ";" #b "m")
 #define CSON_ANSI_END "\e[0m"
@@ -72,13 +88,13 @@
 #define cson_info(msg, ...) (printf("%s%s:%d: " msg CSON_ANSI_END "\n", cson_ansi_rgb(196, 196, 196), __FILE__, __LINE__, ## __VA_ARGS__))
 #ifdef CSON_ERRORS
     #define cson_warning(msg, ...) (fprintf(stderr, "%s%s:%d: [WARNING] " msg CSON_ANSI_END "\n", cson_ansi_rgb(196, 64, 0), __FILE__, __LINE__, ## __VA_ARGS__))
-    #define cson_error(error, msg, ...) (fprintf(stderr, "%s%s:%d [ERROR] (%s): " msg CSON_ANSI_END "\n", cson_ansi_rgb(196, 0, 0), __FILE__, __LINE__, (CsonErrorStrings[(error)]), ## __VA_ARGS__))
+    #define cson_error(error, msg, ...) (*cson__errors_muted()? 0:fprintf(stderr, "%s%s:%d [ERROR] (%s): " msg CSON_ANSI_END "\n", cson_ansi_rgb(196, 0, 0), __FILE__, __LINE__, (CsonErrorStrings[(error)]), ## __VA_ARGS__))
 #else
     #define cson_warning(msg, ...) 
     #define cson_error(error, msg, ...)
 #endif // CSON_ERRORS
 
-#define cson_assert(state, msg, ...) do{if (!(state)) {cson_error(0, msg, ##__VA_ARGS__); exit(1);}} while (0)
+#define cson_assert(state, msg, ...) do{if (!(state)) {*cson__errors_muted() = false; cson_error(0, msg, ##__VA_ARGS__); exit(1);}} while (0)
 #define cson_assert_alloc(alloc) cson_assert((alloc)!=NULL, "Memory allocation failed! (need more RAM :/)")
 
 #define cson_arr_len(arr) ((arr)!= NULL ? sizeof((arr))/sizeof((arr)[0]):0)
@@ -92,6 +108,7 @@ typedef struct CsonArg CsonArg;
 typedef struct CsonStr CsonStr;
 typedef struct CsonArena CsonArena;
 typedef struct CsonRegion CsonRegion;
+typedef struct CsonMapping CsonMapping;
 
 typedef enum {
     Cson_Int,
@@ -128,6 +145,8 @@ typedef enum {
     CsonError_UnclosedString,
     CsonError_IndexError,
     CsonError_KeyError,
+    CsonError_Aborted,
+    CsonError_DepthExceeded,
     CsonError_Any,
     CsonError_None,
     Cson__ErrorCount
@@ -144,6 +163,8 @@ static const char* const CsonErrorStrings[] = {
     [CsonError_EndOfBuffer] = "EndOfBuffer",
     [CsonError_IndexError] = "IndexError",
     [CsonError_KeyError] = "KeyError",
+    [CsonError_Aborted] = "Aborted",
+    [CsonError_DepthExceeded] = "DepthExceeded",
     [CsonError_Unimplemented] = "UNIMPLEMENTED",
     [CsonError_Any] = "Undefined",
     [CsonError_None] = ""
@@ -170,21 +191,26 @@ struct CsonStr{
 };
 
 struct CsonArray{
-    Cson **items;
+    Cson *head; // the first capacity values, stored right after the struct, the rest are in segments
     size_t size;
     size_t capacity;
+    Cson **segments; // the values past capacity, segment s holds CSON_DEF_ARRAY_CAPACITY << s of them
+    CsonArena *arena; // the arena the array grows in
 };
 
 struct CsonMap{
-    CsonMapItem **items;
+    CsonMapItem *items;
+    uint32_t *slots;
     size_t size;
+    size_t used; // items[0..used) includes removed items, their value is NULL
     size_t capacity;
+    CsonArena *arena; // the arena the map grows in
 };
 
 struct CsonMapItem{
     CsonStr key;
+    uint32_t hash;
     Cson *value;
-    CsonMapItem *next;
 };
 
 struct CsonArg{
@@ -201,16 +227,63 @@ struct Cson{
         double floating;
         bool boolean;
         CsonStr string;
+        char small[CSON_SMALL_STRING]; // strings shorter than CSON_SMALL_STRING, '\0' terminated
         CsonArray *array;
         CsonMap *map;
         void *null;
     } value;
     CsonType type;
+    uint8_t small; // 1 + length of a string stored in value.small, 0 for value.string
 };
 
+_Static_assert(CSON_SMALL_STRING <= UINT8_MAX, "CSON_SMALL_STRING has to fit into Cson.small!");
+_Static_assert((CSON_DEF_ARRAY_CAPACITY & (CSON_DEF_ARRAY_CAPACITY-1)) == 0, "CSON_DEF_ARRAY_CAPACITY has to be a power of two!");
+
+// parser buffers that an arena keeps between parses, allocated with malloc
+typedef struct{
+    uint32_t *structurals;
+    uint8_t *grammar_stack;
+    size_t grammar_capacity;
+    void *builder_stack;
+    size_t builder_capacity;
+    Cson *builder_values;
+    size_t builder_values_capacity;
+} CsonParseCache;
+
+typedef struct{
+    CsonStr key;
+    uint32_t hash;
+} CsonInternEntry;
+
+// map keys parsed into an arena, so equal keys share one string, allocated with malloc
+typedef struct{
+    CsonInternEntry *entries; // open addressing, an empty entry has no value
+    size_t count;
+    size_t capacity; // at most CSON_INTERN_CAPACITY, then keys are only looked up
+    size_t hits; // lookups that found a key
+} CsonInternTable;
+
 struct CsonArena{
-    CsonRegion *first, *last;
+    CsonRegion *first, *last; // regions after last are empty and kept for reuse
     size_t region_size;
+    CsonMapping *mappings;
+    void *free_lists[CSON_FREE_CLASSES]; // released blocks, class c holds blocks of at least 2^c words
+    uint64_t free_mask; // bit c is set when free_lists[c] is not empty
+    size_t max_retained; // bytes of regions kept by cson_arena_rewind/reset, 0 keeps all
+    CsonParseCache parse_cache;
+    CsonInternTable interned;
+};
+
+typedef struct{
+    CsonRegion *region;
+    size_t size;
+    CsonMapping *mappings;
+} CsonArenaMark;
+
+struct CsonMapping{
+    void *data;
+    size_t size;
+    CsonMapping *next;
 };
 
 struct CsonRegion{
@@ -220,8 +293,11 @@ struct CsonRegion{
     uintptr_t data[];
 };
 
-extern CsonArena *cson_current_arena;
-extern char cson_temp_buffer[512];
+// the arena used by all functions without an explicit arena, every thread has its own
+#define cson_current_arena (*cson__current_arena())
+LCSON CsonArena** cson__current_arena(void);
+// errors of the calling thread are not reported while this is set, e.g. for a parse that is repeated on failure
+LCSON bool* cson__errors_muted(void);
 
 #define key(kstr) ((CsonArg) {.value.key=cson_str(kstr), .type=CsonArg_Key})
 #define index(istr) ((CsonArg) {.value.index=(size_t)(istr), .type=CsonArg_Index})
@@ -236,27 +312,67 @@ extern char cson_temp_buffer[512];
 #define cson_get_array(out, cson, ...) cson__get_array((out), cson_get(cson, ##__VA_ARGS__))
 #define cson_get_map(out, cson, ...) cson__get_map((out), cson_get(cson, ##__VA_ARGS__))
 
+// precompiled paths: keys are copied and hashed once, the path is independent of any arena
+typedef struct{
+    CsonStr key; // empty for a pure index step
+    uint32_t hash;
+    size_t index; // SIZE_MAX if the step cannot access arrays
+    bool is_key; // the step can access maps
+} CsonPathStep;
+
+typedef struct{
+    CsonPathStep *steps;
+    size_t count;
+} CsonPath;
+
+#define cson_path(...) cson__path_new(cson_args_array((CsonArg){0}, ##__VA_ARGS__))
+
 #define cson__to_int(cson) (cson)->value.integer
 #define cson__to_float(cson) (cson)->value.floating
 #define cson__to_bool(cson) (cson)->value.boolean
-#define cson__to_string(cson) (cson)->value.string
-#define cson__to_cstring(cson) (cson)->value.string.value
+#define cson__to_cstring(cson) cson__to_string(cson).value
 #define cson__to_array(cson) (cson)->value.array
 #define cson__to_map(cson) (cson)->value.map
 
+// scalar values for cson_array_push_value, nothing is allocated
+#define cson_int(v) ((Cson) {.value.integer=(v), .type=Cson_Int})
+#define cson_float(v) ((Cson) {.value.floating=(v), .type=Cson_Float})
+#define cson_bool(v) ((Cson) {.value.boolean=(v), .type=Cson_Bool})
+#define cson_null() ((Cson) {.type=Cson_Null})
+
 LCSON Cson* cson_new(void);
-LCSON Cson* cson_new_int(int32_t value);
+LCSON Cson* cson_new_int(int64_t value);
 LCSON Cson* cson_new_float(double value);
 LCSON Cson* cson_new_bool(bool value);
 LCSON Cson* cson_new_string(CsonStr value);
 LCSON Cson* cson_new_cstring(char *cstr);
 LCSON Cson* cson_new_array(CsonArray *value);
 LCSON Cson* cson_new_map(CsonMap *value);
+LCSON Cson* cson_new_null(void);
+
+// constructors allocating in an explicit arena
+LCSON Cson* cson__new(CsonArena *arena);
+LCSON Cson* cson__new_int(CsonArena *arena, int64_t value);
+LCSON Cson* cson__new_float(CsonArena *arena, double value);
+LCSON Cson* cson__new_bool(CsonArena *arena, bool value);
+LCSON Cson* cson__new_string(CsonArena *arena, CsonStr str); // copied, short strings are stored inline
+LCSON Cson* cson__new_cstring(CsonArena *arena, char *cstr);
+LCSON CsonStr cson__to_string(Cson *cson); // short strings point into the node itself
+LCSON Cson* cson__new_null(CsonArena *arena);
+LCSON Cson* cson__array_new(CsonArena *arena);
+LCSON Cson* cson__array_new_sized(CsonArena *arena, size_t capacity);
+LCSON Cson* cson__map_new(CsonArena *arena);
+LCSON Cson* cson__map_new_sized(CsonArena *arena, size_t count); // room for count keys without growing
 
 LCSON size_t cson_len(Cson *cson);
 LCSON size_t cson_memsize(Cson *cson);
  
 LCSON Cson* cson__get(Cson *cson, CsonArg args[], size_t count);
+LCSON CsonPath* cson__path_new(CsonArg args[], size_t count);
+LCSON CsonPath* cson_path_compile(const char *pointer); // from a JSON Pointer (RFC 6901)
+LCSON void cson_path_free(CsonPath *path);
+LCSON Cson* cson_path_get(Cson *cson, CsonPath *path);
+LCSON size_t cson_get_many(Cson *cson, CsonPath *paths[], size_t count, Cson *out[]);
 LCSON bool cson__get_int(int64_t *out, Cson *cson);
 LCSON bool cson__get_float(double *out, Cson *cson);
 LCSON bool cson__get_bool(bool *out, Cson *cson);
@@ -274,16 +390,22 @@ LCSON bool cson_is_map(Cson *cson);
 LCSON bool cson_is_null(Cson *cson);
  
 LCSON Cson* cson_array_new(void);
-LCSON CsonError cson_array_push(Cson *array, Cson *value);
-LCSON CsonError cson_array_pop(Cson *array, size_t index);
-LCSON Cson* cson_array_get(Cson *array, size_t index);
+LCSON CsonError cson_array_push(Cson *array, Cson *value); // stores a copy of *value, later changes to *value are not seen
+LCSON CsonError cson_array_push_value(Cson *array, Cson value);
+LCSON CsonError cson_array_pop(Cson *array, size_t index); // moves the values after index down by one
+LCSON Cson* cson_array_get(Cson *array, size_t index); // pushing never moves values, popping moves the ones after it
 LCSON Cson* cson_array_get_last(Cson *array);
+LCSON Cson* cson_array_next(Cson *array, size_t *index); // the value at *index and moves *index past it, NULL at the end
+LCSON Cson* cson__array_at(CsonArray *array, size_t index); // no bounds check
 LCSON size_t cson_array_memsize(Cson *array);
 
 LCSON Cson* cson_map_new(void);
+// maps store value itself, a value taken from an array has to stay in place there, see cson_array_get
 LCSON CsonError cson_map_insert(Cson *map, CsonStr key, Cson *value);
+LCSON CsonError cson__map_insert(Cson *map, CsonStr key, uint32_t hash, Cson *value);
 LCSON CsonError cson_map_remove(Cson *map, CsonStr key);
 LCSON Cson* cson_map_get(Cson *map, CsonStr key);
+LCSON Cson* cson__map_get(Cson *map, CsonStr key, uint32_t hash);
 LCSON Cson *cson_map_keys(Cson *map);
 LCSON size_t cson_map_memsize(Cson *map);
 
@@ -291,13 +413,22 @@ LCSON size_t cson_map_memsize(Cson *map);
 LCSON CsonRegion* cson__new_region(size_t capacity);
 LCSON void* cson__alloc(CsonArena *arena, size_t size);
 LCSON void* cson_realloc(CsonArena *arena, void *old_ptr, size_t old_size, size_t new_size);
+LCSON void* cson_dup(CsonArena *arena, void *old_ptr, size_t old_size, size_t new_size);
+LCSON void cson__release(CsonArena *arena, void *ptr, size_t size);
+LCSON CsonArenaMark cson_arena_mark(CsonArena *arena);
+LCSON void cson_arena_rewind(CsonArena *arena, CsonArenaMark mark);
+LCSON void cson_arena_reset(CsonArena *arena);
+LCSON char* cson__map_file(CsonArena *arena, char *filename, size_t *size);
 LCSON void cson_free();
+LCSON void cson__free(CsonArena *arena);
 LCSON void cson_swap_arena(CsonArena *arena);
 LCSON void cson_swap_and_free_arena(CsonArena *arena);
 
 #define cson_str(string) ((CsonStr){.value=(string), .len=strlen(string)})
 LCSON CsonStr cson_str_new(char *cstr);
 LCSON CsonStr cson_str_dup(CsonStr str);
+LCSON CsonStr cson_str_intern(CsonStr str); // the string shared by all equal keys parsed into cson_current_arena
+LCSON CsonStr cson__str_intern(CsonArena *arena, CsonStr str, uint32_t hash);
 LCSON uint32_t cson_str_hash(CsonStr str);
 LCSON bool cson_str_equals(CsonStr a, CsonStr b);
 LCSON size_t cson_str_memsize(CsonStr str);
@@ -312,8 +443,25 @@ LCSON void cson_fprint(Cson *value, FILE *file, size_t indent);
 LCSON void cson_array_fprint(CsonArray *array, FILE *file, size_t indent);
 LCSON void cson_map_fprint(CsonMap *map, FILE *file, size_t indent);
 
+/* Serializer */
+typedef struct{
+    char *data;
+    size_t size;
+    size_t capacity;
+} CsonBuf;
+
+typedef enum{
+    CsonSerialize_Compact = 0,
+    CsonSerialize_Pretty = 1 << 0,
+} CsonSerializeFlags;
+
+LCSON CsonError cson_serialize(Cson *cson, CsonBuf *buf, int flags);
+#define CSON_DTOA_SIZE 32
+LCSON size_t cson__dtoa(double value, char *out);
+LCSON void cson_buf_free(CsonBuf *buf);
+
 /* Lexer */
-#define cson_lex_is_whitespace(c) ((c == ' ' || c == '\n' || c == '\t'))
+#define cson_lex_is_whitespace(c) ((c == ' ' || c == '\n' || c == '\t' || c == '\r'))
 #define cson_lex_check_line(lexer, c) do{if (c == '\n'){(lexer)->loc.row++; (lexer)->loc.column=1;}else{lexer->loc.column++;}}while(0)
 #define cson_lex_inc(lexer) do{lexer->index++; lexer->loc.column++;}while(0)
 #define cson_lex_get_char(lexer) (lexer->buffer[lexer->index])
@@ -321,7 +469,7 @@ LCSON void cson_map_fprint(CsonMap *map, FILE *file, size_t indent);
 #define cson_loc_expand(loc) (loc).filename, (loc).row, (loc).column
 #define cson_token_args_array(...) (CsonTokenType[]){__VA_ARGS__}, cson_args_len(__VA_ARGS__)
 
-#define CSON_LOC_FMT "%s:%d:%d"
+#define CSON_LOC_FMT "%s:%zu:%zu"
 
 typedef enum{
     CsonToken_MapOpen,
@@ -364,14 +512,21 @@ typedef struct{
     char *filename;
     size_t row;
     size_t column;
+    char *origin; // if set, row and column are those of origin and cson_token_loc counts on from there
 } CsonLoc;
 
+typedef union{
+    int64_t integer;
+    double floating;
+} CsonNumber;
+
 typedef struct{
     CsonTokenType type;
     char *t_start;
     char *t_end;
     size_t len;
     CsonLoc loc;
+    CsonNumber number; // converted value of CsonToken_Int and CsonToken_Float
 } CsonToken;
 
 typedef struct{
@@ -379,16 +534,30 @@ typedef struct{
     size_t buffer_size;
     size_t index;
     CsonLoc loc;
+    uint32_t *structurals;
+    size_t structural_count;
+    size_t structural_index;
+    size_t structural_base;
+    size_t indexed;
+    uint64_t index_carry[3];
+    bool insitu; // strings are rewritten in place, so the location is carried past each one
 } CsonLexer;
 
 LCSON CsonLexer cson_lex_init(char *buffer, size_t buffer_size, char *filename);
+LCSON bool cson_lex_index(CsonLexer *lexer);
+LCSON void cson_lex_free(CsonLexer *lexer);
 LCSON bool cson_lex_next(CsonLexer *lexer, CsonToken *token);
 LCSON bool cson__lex_expect(CsonLexer *lexer, CsonToken *token, CsonTokenType types[], size_t count, char *file, size_t line);
 LCSON bool cson_lex_extract(CsonToken *token, char *buffer, size_t buffer_size);
+LCSON size_t cson_lex_unescape(char *dst, const char *src, size_t len);
 LCSON void cson_lex_trim_left(CsonLexer *lexer);
 LCSON bool cson_lex_find(CsonLexer *lexer, char c);
+LCSON bool cson_lex_find_unescaped(CsonLexer *lexer, char c);
 LCSON void cson_lex_set_token(CsonToken *token, CsonTokenType type, char *t_start, char *t_end, CsonLoc loc);
+LCSON CsonLoc cson_token_loc(CsonToken *token);
 LCSON bool cson_lex_is_delimeter(char c);
+LCSON CsonTokenType cson__lex_literal(CsonToken *token);
+LCSON CsonTokenType cson__lex_number(char *s, char *e, CsonNumber *number);
 LCSON bool cson_lex_is_int(char *s, char *e);
 LCSON bool cson_lex_is_float(char *s, char *e);
 
@@ -400,20 +569,362 @@ LCSON bool cson_lex_is_float(char *s, char *e);
 #define cson_error_unexpected(loc, actual, ...) cson__error_unexpected(loc, cson_token_args_array(__VA_ARGS__), actual, __FILE__, __LINE__)
 LCSON void cson__error_unexpected(CsonLoc loc, CsonTokenType expected[], size_t expected_count, CsonTokenType actual, char *filename, size_t line);
 LCSON Cson* cson_parse_buffer(char *buffer, size_t buffer_size, char *filename);
+LCSON Cson* cson_parse_insitu(char *buffer, size_t buffer_size, char *filename);
 LCSON Cson* cson_read(char *filename);
-LCSON bool cson__parse_map(Cson *map, CsonLexer *lexer);
-LCSON bool cson__parse_array(Cson *array, CsonLexer *lexer);
-LCSON bool cson__parse_value(Cson **cson, CsonLexer *lexer, CsonToken *token);
+LCSON Cson* cson__parse(CsonArena *arena, char *buffer, size_t buffer_size, char *filename, bool insitu);
+LCSON Cson* cson__parse_loc(CsonArena *arena, char *buffer, size_t buffer_size, CsonLoc loc, bool insitu);
+LCSON Cson* cson__read(CsonArena *arena, char *filename);
+LCSON CsonStr cson__parse_string(CsonArena *arena, CsonToken *token, bool insitu);
+
+/* Incremental parser */
+typedef struct CsonParser CsonParser;
+LCSON CsonParser* cson_parser_new(char *filename);
+LCSON CsonParser* cson__parser_new(CsonArena *arena, char *filename);
+LCSON CsonError cson_parser_feed(CsonParser *parser, char *chunk, size_t len);
+LCSON Cson* cson_parser_finish(CsonParser *parser);
+LCSON void cson_parser_free(CsonParser *parser);
+
+/* Documents */
+// a document owns all memory of its values, different documents may be used by different threads at the same time
+typedef struct{
+    CsonArena arena;
+    Cson *root;
+} CsonDoc;
+
+LCSON CsonDoc* cson_doc_new(void);
+LCSON void cson_doc_free(CsonDoc *doc);
+LCSON Cson* cson_doc_parse(CsonDoc *doc, char *buffer, size_t buffer_size, char *filename);
+LCSON Cson* cson_doc_parse_insitu(CsonDoc *doc, char *buffer, size_t buffer_size, char *filename);
+LCSON Cson* cson_doc_read(CsonDoc *doc, char *filename);
+LCSON CsonParser* cson_doc_parser_new(CsonDoc *doc, char *filename);
+#define cson_doc_new_int(doc, value) cson__new_int(&(doc)->arena, (value))
+#define cson_doc_new_float(doc, value) cson__new_float(&(doc)->arena, (value))
+#define cson_doc_new_bool(doc, value) cson__new_bool(&(doc)->arena, (value))
+#define cson_doc_new_cstring(doc, cstr) cson__new_cstring(&(doc)->arena, (cstr))
+#define cson_doc_new_null(doc) cson__new_null(&(doc)->arena)
+#define cson_doc_new_array(doc) cson__array_new(&(doc)->arena)
+#define cson_doc_new_map(doc) cson__map_new(&(doc)->arena)
+#define cson_doc_serialize(doc, buf, flags) cson_serialize((doc)->root, (buf), (flags))
+
+/* Binary encoding */
+// CBOR (RFC 8949): native numbers, length-prefixed strings and containers
+LCSON CsonError cson_serialize_binary(Cson *cson, CsonBuf *buf);
+LCSON bool cson_write_binary(Cson *json, char *filename);
+LCSON Cson* cson_parse_binary(char *buffer, size_t buffer_size, char *filename);
+LCSON Cson* cson_read_binary(char *filename);
+LCSON Cson* cson__parse_binary(CsonArena *arena, char *buffer, size_t buffer_size, char *filename);
+LCSON Cson* cson__read_binary(CsonArena *arena, char *filename);
+
+/* Snapshots */
+// a read-only image of a tree that is used in place, e.g. straight from a shared file mapping
+typedef struct{
+    uint32_t type; // CsonType
+    uint32_t len; // bytes of a string, members of an array or map
+    union{
+        int64_t integer;
+        double floating;
+        uint64_t boolean;
+        uint64_t offset; // strings and containers: distance from this value to their data
+    } as;
+} CsonSnapValue;
+
+typedef struct{
+    char *data;
+    size_t size;
+    bool mapped; // data is a file mapping
+    bool owned; // data was allocated by cson_snap_open
+} CsonSnap;
+
+#define cson_snap_get(value, ...) cson__snap_get(value, cson_args_array((CsonArg){0}, ##__VA_ARGS__))
+#define cson_snap_get_int(out, value, ...) cson__snap_get_int((out), cson_snap_get(value, ##__VA_ARGS__))
+#define cson_snap_get_float(out, value, ...) cson__snap_get_float((out), cson_snap_get(value, ##__VA_ARGS__))
+#define cson_snap_get_bool(out, value, ...) cson__snap_get_bool((out), cson_snap_get(value, ##__VA_ARGS__))
+#define cson_snap_get_string(out, value, ...) cson__snap_get_string((out), cson_snap_get(value, ##__VA_ARGS__))
+#define cson_snap_get_cstring(out, value, ...) cson__snap_get_cstring((out), cson_snap_get(value, ##__VA_ARGS__))
+
+LCSON CsonError cson_snap_serialize(Cson *cson, CsonBuf *buf); // buf has to be empty
+LCSON bool cson_snap_write(Cson *cson, char *filename);
+// only the header is checked, offsets and types are not validated, so snapshots have to come from a trusted writer
+LCSON bool cson_snap_open(CsonSnap *snap, char *filename);
+LCSON bool cson_snap_init(CsonSnap *snap, char *buffer, size_t buffer_size); // buffer is used in place and has to be 8 byte aligned
+LCSON void cson_snap_close(CsonSnap *snap);
+LCSON const CsonSnapValue* cson_snap_root(CsonSnap *snap);
+LCSON size_t cson_snap_len(const CsonSnapValue *value);
+LCSON const CsonSnapValue* cson_snap_array_get(const CsonSnapValue *array, size_t index);
+LCSON const CsonSnapValue* cson_snap_map_get(const CsonSnapValue *map, CsonStr key);
+LCSON const CsonSnapValue* cson_snap_map_item(const CsonSnapValue *map, size_t index, CsonStr *key); // in insertion order
+LCSON const CsonSnapValue* cson__snap_get(const CsonSnapValue *value, CsonArg args[], size_t count);
+LCSON bool cson__snap_get_int(int64_t *out, const CsonSnapValue *value);
+LCSON bool cson__snap_get_float(double *out, const CsonSnapValue *value);
+LCSON bool cson__snap_get_bool(bool *out, const CsonSnapValue *value);
+LCSON bool cson__snap_get_string(CsonStr *out, const CsonSnapValue *value); // points into the snapshot, never write to it
+LCSON bool cson__snap_get_cstring(char **out, const CsonSnapValue *value);
+
+/* Parallel parser */
+// splits the root container into chunks parsed on threads = 0 uses one per cpu, needs CSON_THREADS
+#define CSON_PARALLEL_MIN_SIZE 1024*1024
+LCSON Cson* cson_parse_parallel(char *buffer, size_t buffer_size, char *filename, size_t threads);
+LCSON Cson* cson_read_parallel(char *filename, size_t threads);
+LCSON Cson* cson__parse_parallel(CsonArena *arena, char *buffer, size_t buffer_size, char *filename, bool insitu, size_t threads);
+LCSON void cson__arena_adopt(CsonArena *arena, CsonArena *other);
+
+/* Line-delimited parser */
+// parses one value per line (NDJSON) in batches, records are only valid during the callback
+#define CSON_LINES_BATCH 256*1024
+typedef enum{
+    CsonLines_Ordered = 0,
+    CsonLines_Unordered = 1 << 0,
+} CsonLinesFlags;
+
+typedef bool (*CsonLineFn)(Cson *record, size_t line, void *user); // record is NULL for an invalid line, return false to stop
+
+LCSON CsonError cson_parse_lines(char *buffer, size_t buffer_size, char *filename, CsonLineFn callback, void *user, size_t threads, int flags);
+LCSON CsonError cson_read_lines(char *filename, CsonLineFn callback, void *user, size_t threads, int flags);
+
+/* Queries */
+// JSONPath expressions (RFC 9535 subset), compiled once and evaluated lazily
+typedef enum{
+    CsonSelector_Name,
+    CsonSelector_Wildcard,
+    CsonSelector_Index,
+    CsonSelector_Slice,
+    CsonSelector_Filter,
+} CsonSelectorType;
+
+typedef struct{
+    CsonSelectorType type;
+    CsonStr name;
+    uint32_t hash;
+    int64_t start; // also the index of CsonSelector_Index
+    int64_t end;
+    int64_t step;
+    bool has_start;
+    bool has_end;
+    size_t filter; // root expression of CsonSelector_Filter
+} CsonSelector;
+
+typedef struct{
+    size_t first; // first selector of the segment
+    size_t count;
+    bool descendant; // '..' applies the selectors to every descendant as well
+} CsonSegment;
+
+typedef enum{
+    CsonExpr_Or,
+    CsonExpr_And,
+    CsonExpr_Not,
+    CsonExpr_Exists,
+    CsonExpr_Compare,
+} CsonExprType;
+
+typedef enum{
+    CsonCompare_Eq,
+    CsonCompare_Ne,
+    CsonCompare_Lt,
+    CsonCompare_Le,
+    CsonCompare_Gt,
+    CsonCompare_Ge,
+} CsonCompareOp;
+
+typedef struct{
+    CsonPath *path; // NULL for a literal
+    bool absolute; // the path starts at '$' instead of '@'
+    Cson literal;
+} CsonOperand;
+
+typedef struct{
+    CsonExprType type;
+    CsonCompareOp op;
+    size_t left; // operands of Or, And and Not
+    size_t right;
+    CsonOperand operands[2]; // Exists only uses the first
+} CsonExpr;
+
+typedef struct{
+    CsonSegment *segments;
+    size_t segment_count;
+    CsonSelector *selectors;
+    size_t selector_count;
+    CsonExpr *exprs;
+    size_t expr_count;
+    char *strings; // unescaped names and string literals
+} CsonQuery;
+
+typedef struct{
+    Cson *node;
+    size_t segment;
+    size_t selector; // selector of the segment that is applied to node
+    size_t position; // progress of the selector
+    bool descending; // the selectors are done, a descendant segment continues with the children
+} CsonQueryFrame;
+
+typedef struct{
+    CsonQuery *query;
+    Cson *root;
+    CsonQueryFrame *stack;
+    size_t depth;
+    size_t capacity;
+} CsonQueryIter;
+
+LCSON CsonQuery* cson_query_compile(const char *expression);
+LCSON void cson_query_free(CsonQuery *query);
+LCSON CsonQueryIter cson_query_iter(CsonQuery *query, Cson *cson);
+LCSON Cson* cson_query_next(CsonQueryIter *iter); // NULL after the last match
+LCSON void cson_query_iter_free(CsonQueryIter *iter);
+
+/* Lazy parser */
+// on-demand access to a buffer: only the structural index is built, values are parsed when they are read
+typedef struct{
+    char *buffer;
+    size_t buffer_size;
+    char *filename;
+    uint32_t *entries; // absolute positions of the structural index entries, allocated with malloc
+    size_t count;
+    size_t capacity;
+} CsonLazyDoc;
+
+typedef struct{
+    CsonLazyDoc *doc; // NULL if the value does not exist
+    size_t entry; // index entry of the first character of the value
+} CsonLazy;
+
+#define cson_lazy_valid(value) ((value).doc != NULL)
+#define cson_lazy_get(value, ...) cson__lazy_get(value, cson_args_array((CsonArg){0}, ##__VA_ARGS__))
+#define cson_lazy_get_int(out, value, ...) cson__lazy_get_int((out), cson_lazy_get(value, ##__VA_ARGS__))
+#define cson_lazy_get_float(out, value, ...) cson__lazy_get_float((out), cson_lazy_get(value, ##__VA_ARGS__))
+#define cson_lazy_get_bool(out, value, ...) cson__lazy_get_bool((out), cson_lazy_get(value, ##__VA_ARGS__))
+#define cson_lazy_get_string(out, value, ...) cson__lazy_get_string((out), cson_lazy_get(value, ##__VA_ARGS__))
+#define cson_lazy_get_cstring(out, value, ...) cson__lazy_get_cstring((out), cson_lazy_get(value, ##__VA_ARGS__))
+
+LCSON bool cson_lazy_init(CsonLazyDoc *doc, char *buffer, size_t buffer_size, char *filename); // a doc may be initialized again, the index memory is reused
+LCSON void cson_lazy_free(CsonLazyDoc *doc);
+LCSON CsonLazy cson_lazy_root(CsonLazyDoc *doc);
+LCSON CsonType cson_lazy_type(CsonLazy value); // Cson__TypeCount for a missing value
+LCSON size_t cson_lazy_len(CsonLazy value);
+LCSON CsonLazy cson_lazy_key(CsonLazy map, CsonStr key);
+LCSON CsonLazy cson_lazy_index(CsonLazy array, size_t index);
+LCSON Cson* cson_lazy_build(CsonLazy value); // parses the value into cson_current_arena
+LCSON CsonLazy cson__lazy_get(CsonLazy value, CsonArg args[], size_t count);
+LCSON bool cson__lazy_get_int(int64_t *out, CsonLazy value);
+LCSON bool cson__lazy_get_float(double *out, CsonLazy value);
+LCSON bool cson__lazy_get_bool(bool *out, CsonLazy value);
+LCSON bool cson__lazy_get_string(CsonStr *out, CsonLazy value); // copied into cson_current_arena
+LCSON bool cson__lazy_get_cstring(char **out, CsonLazy value);
+
+/* Tape */
+// a flat tree: every value is a 64 bit slot in one array, containers know where they end, strings are in a side buffer
+typedef struct{
+    size_t open; // slot of the container
+    size_t count;
+} CsonTapeFrame;
+
+typedef struct{
+    uint64_t *slots; // tag in the top byte, payload below
+    size_t count;
+    size_t capacity;
+    char *strings; // a uint32_t length, the bytes and a '\0' per string
+    size_t strings_size;
+    size_t strings_capacity;
+    // parser buffers kept between parses
+    CsonTapeFrame *frames;
+    size_t frame_capacity;
+    uint32_t *structurals;
+    uint8_t *grammar_stack;
+    size_t grammar_capacity;
+} CsonTape;
+
+typedef struct{
+    CsonTape *tape; // NULL if the value does not exist
+    size_t slot;
+} CsonTapeRef;
+
+#define cson_tape_valid(ref) ((ref).tape != NULL)
+#define cson_tape_is_int(ref) (cson_tape_type(ref) == Cson_Int)
+#define cson_tape_is_float(ref) (cson_tape_type(ref) == Cson_Float)
+#define cson_tape_is_bool(ref) (cson_tape_type(ref) == Cson_Bool)
+#define cson_tape_is_string(ref) (cson_tape_type(ref) == Cson_String)
+#define cson_tape_is_array(ref) (cson_tape_type(ref) == Cson_Array)
+#define cson_tape_is_map(ref) (cson_tape_type(ref) == Cson_Map)
+#define cson_tape_is_null(ref) (cson_tape_type(ref) == Cson_Null)
+#define cson_tape_get(ref, ...) cson__tape_get(ref, cson_args_array((CsonArg){0}, ##__VA_ARGS__))
+#define cson_tape_get_int(out, ref, ...) cson__tape_get_int((out), cson_tape_get(ref, ##__VA_ARGS__))
+#define cson_tape_get_float(out, ref, ...) cson__tape_get_float((out), cson_tape_get(ref, ##__VA_ARGS__))
+#define cson_tape_get_bool(out, ref, ...) cson__tape_get_bool((out), cson_tape_get(ref, ##__VA_ARGS__))
+#define cson_tape_get_string(out, ref, ...) cson__tape_get_string((out), cson_tape_get(ref, ##__VA_ARGS__))
+#define cson_tape_get_cstring(out, ref, ...) cson__tape_get_cstring((out), cson_tape_get(ref, ##__VA_ARGS__))
+
+LCSON bool cson_tape_parse(CsonTape *tape, char *buffer, size_t buffer_size, char *filename); // the memory of a previous parse is reused
+LCSON void cson_tape_free(CsonTape *tape);
+LCSON CsonTapeRef cson_tape_root(CsonTape *tape);
+LCSON CsonType cson_tape_type(CsonTapeRef ref); // Cson__TypeCount for a missing value
+LCSON size_t cson_tape_len(CsonTapeRef ref);
+LCSON CsonTapeRef cson_tape_first(CsonTapeRef container); // for maps the first key
+LCSON CsonTapeRef cson_tape_next(CsonTapeRef ref); // the following key or value in the same container
+LCSON CsonTapeRef cson_tape_key(CsonTapeRef map, CsonStr key); // the last member with the key, like cson_map_get
+LCSON CsonTapeRef cson_tape_index(CsonTapeRef array, size_t index);
+LCSON CsonError cson_tape_serialize(CsonTapeRef ref, CsonBuf *buf, int flags);
+LCSON CsonTapeRef cson__tape_get(CsonTapeRef ref, CsonArg args[], size_t count);
+LCSON bool cson__tape_get_int(int64_t *out, CsonTapeRef ref);
+LCSON bool cson__tape_get_float(double *out, CsonTapeRef ref);
+LCSON bool cson__tape_get_bool(bool *out, CsonTapeRef ref);
+LCSON bool cson__tape_get_string(CsonStr *out, CsonTapeRef ref); // valid until the tape is parsed again
+LCSON bool cson__tape_get_cstring(char **out, CsonTapeRef ref);
+
+/* SAX parser */
+// every callback may be NULL, returning false aborts the parse
+typedef struct{
+    bool (*begin_map)(void *user);
+    bool (*end_map)(void *user);
+    bool (*begin_array)(void *user);
+    bool (*end_array)(void *user);
+    bool (*map_key)(void *user, CsonStr key);
+    bool (*integer)(void *user, int64_t value);
+    bool (*floating)(void *user, double value);
+    bool (*string)(void *user, CsonStr value);
+    bool (*boolean)(void *user, bool value);
+    bool (*null)(void *user);
+} CsonSax;
+
+LCSON CsonError cson_sax_parse(char *buffer, size_t buffer_size, char *filename, CsonSax *sax, void *user);
+LCSON CsonError cson_sax_read(char *filename, CsonSax *sax, void *user);
 
 #endif // _CSON_H
 
 /* cson.c */
 #ifdef CSON_IMPLEMENTATION
 
-static CsonArena cson_default_arena = {0};
-CsonArena *cson_current_arena = &cson_default_arena;
+#if defined(__unix__) || defined(__APPLE__)
+    #define CSON__MMAP
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#ifdef CSON_THREADS
+    #ifdef _WIN32
+        #include <windows.h>
+    #else
+        #include <pthread.h>
+        #include <unistd.h>
+    #endif
+#endif // CSON_THREADS
+
+static CSON_THREAD_LOCAL CsonArena cson_default_arena = {0};
+static CSON_THREAD_LOCAL CsonArena *cson__arena = NULL;
+
+CsonArena** cson__current_arena(void)
+{
+    // the address of a thread local is no constant initializer
+    if (cson__arena == NULL) cson__arena = &cson_default_arena;
+    return &cson__arena;
+}
+
+static CSON_THREAD_LOCAL bool cson__muted = false;
 
-char cson_temp_buffer[512] = {0};
+bool* cson__errors_muted(void)
+{
+    return &cson__muted;
+}
 
 Cson* cson__get(Cson *cson, CsonArg args[], size_t count)
 {
@@ -445,6 +956,166 @@ Cson* cson__get(Cson *cson, CsonArg args[], size_t count)
     return next;
 }
 
+CsonPath* cson__path_new(CsonArg args[], size_t count)
+{
+    // the steps and the copied keys share one allocation
+    size_t size = sizeof(CsonPath) + count*sizeof(CsonPathStep);
+    for (size_t i=0; i<count; ++i){
+        if (args[i].type == CsonArg_Key) size += args[i].value.key.len + 1;
+    }
+    CsonPath *path = malloc(size);
+    cson_assert_alloc(path);
+    path->steps = (CsonPathStep*) (path + 1);
+    path->count = count;
+    char *keys = (char*) (path->steps + count);
+    for (size_t i=0; i<count; ++i){
+        CsonArg arg = args[i];
+        if (arg.type == CsonArg_Key){
+            memcpy(keys, arg.value.key.value, arg.value.key.len);
+            keys[arg.value.key.len] = '\0';
+            CsonStr key = {.value=keys, .len=arg.value.key.len};
+            path->steps[i] = (CsonPathStep) {.key=key, .hash=cson_str_hash(key), .index=SIZE_MAX, .is_key=true};
+            keys += key.len + 1;
+        }
+        else{
+            path->steps[i] = (CsonPathStep) {.index=arg.value.index, .is_key=false};
+        }
+    }
+    return path;
+}
+
+CsonPath* cson_path_compile(const char *pointer)
+{
+    if (pointer == NULL) return NULL;
+    if (*pointer != '\0' && *pointer != '/'){
+        cson_error(CsonError_InvalidParam, "JSON Pointer must start with '/': \"%s\"", pointer);
+        return NULL;
+    }
+    // unescaping only shortens the tokens, so the pointer length bounds the keys
+    size_t count = 0;
+    size_t len = strlen(pointer);
+    for (size_t i=0; i<len; ++i) count += (pointer[i] == '/');
+    CsonPath *path = malloc(sizeof(CsonPath) + count*sizeof(CsonPathStep) + len + count);
+    cson_assert_alloc(path);
+    path->steps = (CsonPathStep*) (path + 1);
+    path->count = count;
+    char *keys = (char*) (path->steps + count);
+    const char *p = pointer;
+    for (size_t i=0; i<count; ++i){
+        ++p; // skip the '/'
+        CsonStr key = {.value=keys, .len=0};
+        for (; *p != '\0' && *p != '/'; ++p){
+            if (*p == '~'){
+                if (p[1] != '0' && p[1] != '1'){
+                    cson_error(CsonError_InvalidParam, "Invalid escape in JSON Pointer: \"%s\"", pointer);
+                    free(path);
+                    return NULL;
+                }
+                key.value[key.len++] = (p[1] == '0')? '~':'/';
+                ++p;
+            }
+            else key.value[key.len++] = *p;
+        }
+        key.value[key.len] = '\0';
+        keys += key.len + 1;
+        // a token is an array index if it is a number without leading zeros
+        size_t index = SIZE_MAX;
+        if (key.len > 0 && key.len < 20 && (key.len == 1 || key.value[0] != '0')){
+            index = 0;
+            for (size_t j=0; j<key.len && index != SIZE_MAX; ++j){
+                index = ((uint8_t) (key.value[j] - '0') < 10)? index*10 + (size_t) (key.value[j] - '0'):SIZE_MAX;
+            }
+        }
+        path->steps[i] = (CsonPathStep) {.key=key, .hash=cson_str_hash(key), .index=index, .is_key=true};
+    }
+    return path;
+}
+
+void cson_path_free(CsonPath *path)
+{
+    free(path);
+}
+
+static Cson* cson__path_step(Cson *cson, CsonPathStep *step)
+{
+    if (step->is_key && cson->type == Cson_Map){
+        Cson *next = cson__map_get(cson, step->key, step->hash);
+        if (next == NULL){
+            cson_error(CsonError_KeyError, "No such key in map: \"%s\"", step->key.value);
+        }
+        return next;
+    }
+    if (step->index != SIZE_MAX && cson->type == Cson_Array){
+        Cson *next = cson_array_get(cson, step->index);
+        if (next == NULL){
+            cson_error(CsonError_IndexError, "Index out of bounds for array of size %zu: %zu", cson_len(cson), step->index);
+        }
+        return next;
+    }
+    cson_error(CsonError_InvalidType, "Cannot access %s via %s!", CsonTypeStrings[cson->type], CsonArgStrings[step->is_key? CsonArg_Key:CsonArg_Index]);
+    return NULL;
+}
+
+Cson* cson_path_get(Cson *cson, CsonPath *path)
+{
+    if (cson == NULL || path == NULL) return NULL;
+    for (size_t i=0; i<path->count && cson != NULL; ++i){
+        cson = cson__path_step(cson, &path->steps[i]);
+    }
+    return cson;
+}
+
+static bool cson__path_step_equals(CsonPathStep *a, CsonPathStep *b)
+{
+    return a->is_key == b->is_key && a->index == b->index && a->hash == b->hash && cson_str_equals(a->key, b->key);
+}
+
+// looks up several paths, the steps shared with the previous path are not repeated
+size_t cson_get_many(Cson *cson, CsonPath *paths[], size_t count, Cson *out[])
+{
+    if (paths == NULL || out == NULL) return 0;
+    // nodes[i] is the value reached after i steps of the previous path
+    Cson *small[32];
+    Cson **nodes = small;
+    size_t capacity = cson_arr_len(small);
+    size_t resolved = 1;
+    nodes[0] = cson;
+    CsonPath *prev = NULL;
+    size_t found = 0;
+    for (size_t i=0; i<count; ++i){
+        CsonPath *path = paths[i];
+        out[i] = NULL;
+        if (cson == NULL || path == NULL) continue;
+        if (path->count >= capacity){
+            Cson **grown = malloc((path->count+1)*sizeof(*grown));
+            cson_assert_alloc(grown);
+            memcpy(grown, nodes, resolved*sizeof(*nodes));
+            if (nodes != small) free(nodes);
+            nodes = grown;
+            capacity = path->count+1;
+        }
+        size_t depth = 0;
+        size_t shared = (resolved-1 < path->count)? resolved-1:path->count;
+        if (prev == path) depth = shared;
+        else if (prev != NULL){
+            while (depth < shared && cson__path_step_equals(&prev->steps[depth], &path->steps[depth])) depth++;
+        }
+        for (; depth < path->count; ++depth){
+            Cson *next = cson__path_step(nodes[depth], &path->steps[depth]);
+            if (next == NULL) break;
+            nodes[depth+1] = next;
+        }
+        prev = path;
+        resolved = depth+1;
+        if (depth == path->count){
+            out[i] = nodes[depth];
+            found++;
+        }
+    }
+    if (nodes != small) free(nodes);
+    return found;
+}
+
 size_t cson_len(Cson *cson)
 {
     if (cson == NULL) return 0;
@@ -465,7 +1136,7 @@ size_t cson_memsize(Cson *cson)
     switch (cson->type){
         case Cson_Array: total += cson_array_memsize(cson); break;
         case Cson_Map: total += cson_map_memsize(cson); break;
-        case Cson_String: total += cson_str_memsize(cson->value.string); break;
+        case Cson_String: if (cson->small == 0) total += cson_str_memsize(cson->value.string); break;
         default: break;
     }
     return total;
@@ -473,62 +1144,110 @@ size_t cson_memsize(Cson *cson)
 
 /* Cson constructors */
 
-Cson* cson_new(void)
+Cson* cson__new(CsonArena *arena)
 {
-    Cson *cson = cson_alloc(sizeof(*cson));
+    Cson *cson = cson__alloc(arena, sizeof(*cson));
     cson_assert_alloc(cson);
     return cson;
 }
 
-Cson* cson_new_int(int32_t value)
+Cson* cson__new_int(CsonArena *arena, int64_t value)
 {
-    Cson *cson = cson_alloc(sizeof(*cson));
-    cson_assert_alloc(cson);
+    Cson *cson = cson__new(arena);
     cson->type = Cson_Int;
     cson->value.integer = value;
     return cson;
 }
 
-Cson* cson_new_float(double value)
+Cson* cson__new_float(CsonArena *arena, double value)
 {
-    Cson *cson = cson_alloc(sizeof(*cson));
-    cson_assert_alloc(cson);
+    Cson *cson = cson__new(arena);
     cson->type = Cson_Float;
     cson->value.floating = value;
     return cson;
 }
 
-Cson* cson_new_bool(bool value)
+Cson* cson__new_bool(CsonArena *arena, bool value)
 {
-    Cson *cson = cson_alloc(sizeof(*cson));
-    cson_assert_alloc(cson);
+    Cson *cson = cson__new(arena);
     cson->type = Cson_Bool;
     cson->value.boolean = value;
     return cson;
 }
 
-Cson* cson_new_string(CsonStr value)
+// cson has to be zeroed, the terminator of an inline string is not written
+static void cson__set_string(CsonArena *arena, Cson *cson, CsonStr str)
 {
-    Cson *cson = cson_alloc(sizeof(*cson));
-    cson_assert_alloc(cson);
     cson->type = Cson_String;
-    cson->value.string = cson_str_new(value.value);
+    if (str.len < CSON_SMALL_STRING){
+        memcpy(cson->value.small, str.value, str.len);
+        cson->small = (uint8_t) (str.len + 1);
+    }
+    else{
+        cson->value.string = (CsonStr) {.value=cson_dup(arena, str.value, str.len, str.len+1), .len=str.len};
+    }
+}
+
+Cson* cson__new_string(CsonArena *arena, CsonStr str)
+{
+    Cson *cson = cson__new(arena);
+    cson__set_string(arena, cson, str);
     return cson;
 }
 
-Cson* cson_new_cstring(char *cstr)
+Cson* cson__new_cstring(CsonArena *arena, char *cstr)
 {
-    Cson *cson = cson_alloc(sizeof(*cson));
-    cson_assert_alloc(cson);
-    cson->type = Cson_String;
-    cson->value.string = cson_str_new(cstr);
+    return cson__new_string(arena, cson_str(cstr));
+}
+
+CsonStr cson__to_string(Cson *cson)
+{
+    if (cson->small != 0) return (CsonStr) {.value=cson->value.small, .len=cson->small - 1u};
+    return cson->value.string;
+}
+
+Cson* cson__new_null(CsonArena *arena)
+{
+    Cson *cson = cson__new(arena);
+    cson->type = Cson_Null;
+    cson->value.null = NULL;
     return cson;
 }
 
+Cson* cson_new(void)
+{
+    return cson__new(cson_current_arena);
+}
+
+Cson* cson_new_int(int64_t value)
+{
+    return cson__new_int(cson_current_arena, value);
+}
+
+Cson* cson_new_float(double value)
+{
+    return cson__new_float(cson_current_arena, value);
+}
+
+Cson* cson_new_bool(bool value)
+{
+    return cson__new_bool(cson_current_arena, value);
+}
+
+Cson* cson_new_string(CsonStr value)
+{
+    return cson__new_string(cson_current_arena, value);
+}
+
+Cson* cson_new_cstring(char *cstr)
+{
+    return cson__new_cstring(cson_current_arena, cstr);
+}
+
 Cson* cson_new_array(CsonArray *value)
 {
-    Cson *cson = cson_alloc(sizeof(*cson));
-    cson_assert_alloc(cson);
+    Cson *cson = cson_new();
+    if (value != NULL && value->arena == NULL) value->arena = cson_current_arena;
     cson->type = Cson_Array;
     cson->value.array = value;
     return cson;
@@ -536,8 +1255,8 @@ Cson* cson_new_array(CsonArray *value)
 
 Cson* cson_new_map(CsonMap *value)
 {
-    Cson *cson = cson_alloc(sizeof(*cson));
-    cson_assert_alloc(cson);
+    Cson *cson = cson_new();
+    if (value != NULL && value->arena == NULL) value->arena = cson_current_arena;
     cson->type = Cson_Map;
     cson->value.map = value;
     return cson;
@@ -545,11 +1264,7 @@ Cson* cson_new_map(CsonMap *value)
 
 Cson* cson_new_null(void)
 {
-    Cson *cson = cson_alloc(sizeof(*cson));
-    cson_assert_alloc(cson);
-    cson->type = Cson_Null;
-    cson->value.null = NULL;
-    return cson;
+    return cson__new_null(cson_current_arena);
 }
 
 bool cson__get_int(int64_t *out, Cson *cson)
@@ -576,14 +1291,15 @@ bool cson__get_bool(bool *out, Cson *cson)
 bool cson__get_string(CsonStr *out, Cson *cson)
 {
     if (cson == NULL || out == NULL || cson->type != Cson_String) return false;
-    *out = cson->value.string;
+    *out = cson__to_string(cson);
     return true;
 }
 
 bool cson__get_cstring(char **out, Cson *cson)
 {
     if (cson == NULL || out == NULL || cson->type != Cson_String) return false;
-    *out = cson->value.string.value;
+    *out = cson__to_cstring(cson);
+    return true;
 }
 
 bool cson__get_array(CsonArray **out, Cson *cson)
@@ -637,41 +1353,105 @@ bool cson_is_null(Cson *cson)
 
 /* Array implementation */
 
-Cson* cson_array_new(void)
+Cson* cson__array_new(CsonArena *arena)
+{
+    return cson__array_new_sized(arena, CSON_DEF_ARRAY_CAPACITY);
+}
+
+// the first capacity values share the allocation of the array
+static CsonArray* cson__array_create(CsonArena *arena, size_t capacity)
 {
-    CsonArray *array = cson_alloc(sizeof(*array) + CSON_DEF_ARRAY_CAPACITY*sizeof(Cson*));
+    CsonArray *array = cson__alloc(arena, sizeof(CsonArray) + capacity*sizeof(Cson));
     cson_assert_alloc(array);
     array->size = 0;
-    array->capacity = CSON_DEF_ARRAY_CAPACITY;
-    array->items = (Cson**) (array+1);
-    return cson_new_array(array);
+    array->capacity = capacity;
+    array->head = (Cson*) (array+1);
+    array->segments = NULL;
+    array->arena = arena;
+    return array;
+}
+
+Cson* cson__array_new_sized(CsonArena *arena, size_t capacity)
+{
+    Cson *cson = cson__new(arena);
+    cson->type = Cson_Array;
+    cson->value.array = cson__array_create(arena, capacity);
+    return cson;
+}
+
+Cson* cson_array_new(void)
+{
+    return cson__array_new(cson_current_arena);
+}
+
+static size_t cson__log2(size_t value)
+{
+#if defined(__GNUC__)
+    return sizeof(unsigned long long)*8 - 1 - (size_t) __builtin_clzll(value);
+#else
+    size_t log = 0;
+    while (value >>= 1) log++;
+    return log;
+#endif
+}
+
+// a grown array never moves its values: the inline block stays and every growth adds a segment
+// twice the size of the previous one, so a value is found with a shift instead of a search
+Cson* cson__array_at(CsonArray *array, size_t index)
+{
+    if (index < array->capacity) return &array->head[index];
+    // counted from CSON_DEF_ARRAY_CAPACITY, segment s starts at the power of two CSON_DEF_ARRAY_CAPACITY << s
+    size_t position = index - array->capacity + CSON_DEF_ARRAY_CAPACITY;
+    size_t high = cson__log2(position);
+    return &array->segments[high - cson__log2(CSON_DEF_ARRAY_CAPACITY)][position - ((size_t) 1 << high)];
 }
 
 CsonError cson_array_push(Cson *array, Cson *value)
 {
-    if (array == NULL || value == NULL) return CsonError_InvalidParam;
+    if (value == NULL) return CsonError_InvalidParam;
+    return cson_array_push_value(array, *value);
+}
+
+// the array holds a copy of value, strings and containers are shared with the original
+CsonError cson_array_push_value(Cson *array, Cson value)
+{
+    if (array == NULL) return CsonError_InvalidParam;
     if (array->type != Cson_Array) return CsonError_InvalidType;
     CsonArray *arr = array->value.array;
-    if (arr->size >= arr->capacity){
-        size_t new_capacity = arr->capacity * CSON_ARRAY_MUL_F;
-        arr->items = cson_realloc(cson_current_arena, arr->items, arr->capacity*sizeof(Cson*), new_capacity*sizeof(Cson));
-        arr->capacity = new_capacity;
+    size_t position = arr->size - arr->capacity + CSON_DEF_ARRAY_CAPACITY;
+    if (arr->size >= arr->capacity && (position & (position-1)) == 0){
+        // every segment is full, so count is the index of the new one
+        size_t count = cson__log2(position) - cson__log2(CSON_DEF_ARRAY_CAPACITY);
+        // the table of segments doubles from 4 entries, moving it leaves the values in place
+        if (count == 0 || (count >= 4 && (count & (count-1)) == 0)){
+            arr->segments = cson_realloc(arr->arena, arr->segments, count*sizeof(Cson*), ((count == 0)? 4:count*2)*sizeof(Cson*));
+            cson_assert_alloc(arr->segments);
+        }
+        arr->segments[count] = cson__alloc(arr->arena, ((size_t) CSON_DEF_ARRAY_CAPACITY << count)*sizeof(Cson));
+        cson_assert_alloc(arr->segments[count]);
     }
-    arr->items[arr->size++] = value;
+    *cson__array_at(arr, arr->size++) = value;
     return CsonError_Success;
 }
 
 Cson* cson_array_get(Cson *array, size_t index)
 {
     if (array == NULL || array->type != Cson_Array || index >= cson_len(array)) return NULL;
-    return cson__to_array(array)->items[index];
+    return cson__array_at(cson__to_array(array), index);
 }
 
 Cson* cson_array_get_last(Cson *array)
 {
     if (array == NULL || array->type != Cson_Array || cson_len(array) == 0) return NULL;
     CsonArray *arr = cson__to_array(array);
-    return arr->items[arr->size-1];
+    return cson__array_at(arr, arr->size-1);
+}
+
+Cson* cson_array_next(Cson *array, size_t *index)
+{
+    if (array == NULL || index == NULL || array->type != Cson_Array) return NULL;
+    CsonArray *arr = cson__to_array(array);
+    return (*index < arr->size)? cson__array_at(arr, (*index)++):NULL;
 }
 
 CsonError cson_array_pop(Cson *array, size_t index)
@@ -680,9 +1460,13 @@ CsonError cson_array_pop(Cson *array, size_t index)
     if (array->type != Cson_Array) return CsonError_InvalidType;
     CsonArray *arr = cson__to_array(array);
     if (index >= arr->size) return CsonError_IndexError;
-    for (size_t i=index; i<arr->capacity-1; ++i){
-        arr->items[i] = arr->items[i+1];
+    if (arr->size <= arr->capacity){
+        memmove(&arr->head[index], &arr->head[index+1], (arr->size-index-1)*sizeof(Cson));
+    }
+    else{
+        for (size_t i=index; i+1<arr->size; ++i) *cson__array_at(arr, i) = *cson__array_at(arr, i+1);
     }
+    memset(cson__array_at(arr, --arr->size), 0, sizeof(Cson));
     return CsonError_Success;
 }
 
@@ -692,108 +1476,188 @@ size_t cson_array_memsize(Cson *array)
     size_t total = sizeof(CsonArray);
     CsonArray *arr = cson__to_array(array);
     for (size_t i=0; i<arr->size; ++i){
-        total += cson_memsize(arr->items[i]);
+        total += cson_memsize(cson__array_at(arr, i));
     }
     return total;
 }
 
 /* Map implementation */
 
-Cson* cson_map_new(void)
+// items hold the entries in insertion order, slots is an open addressing
+// table (linear probing) of item indices offset by one, 0 marks an empty slot.
+// removed items stay in place with a NULL value until the next rehash
+#define cson__map_item_capacity(capacity) ((capacity)*CSON_MAP_MAX_LOAD/100)
+
+Cson* cson__map_new(CsonArena *arena)
+{
+    return cson__map_new_sized(arena, cson__map_item_capacity(CSON_MAP_CAPACITY));
+}
+
+static CsonMap* cson__map_create(CsonArena *arena, size_t count)
 {
-    CsonMap *map = cson_alloc(sizeof(*map) + CSON_MAP_CAPACITY*sizeof(CsonMapItem*));
+    // the smallest table that holds count keys below the maximum load
+    size_t capacity = 2;
+    while (cson__map_item_capacity(capacity) < count) capacity *= 2;
+    size_t item_capacity = cson__map_item_capacity(capacity);
+    CsonMap *map = cson__alloc(arena, sizeof(CsonMap) + item_capacity*sizeof(CsonMapItem) + capacity*sizeof(uint32_t));
     cson_assert_alloc(map);
     map->size = 0;
-    map->capacity = CSON_MAP_CAPACITY;
-    map->items = (CsonMapItem**) (map+1);
-    cson_assert_alloc(map->items);
-    return cson_new_map(map);
+    map->used = 0;
+    map->capacity = capacity;
+    map->items = (CsonMapItem*) (map+1);
+    map->slots = (uint32_t*) (map->items + item_capacity);
+    map->arena = arena;
+    // arena memory is zeroed, so the slots start out empty
+    return map;
 }
 
-CsonMapItem* cson_map_item_new(CsonStr key, Cson *value)
+Cson* cson__map_new_sized(CsonArena *arena, size_t count)
 {
-    CsonMapItem *item = cson_alloc(sizeof(*item));
-    cson_assert_alloc(item);
-    item->key = key;
-    item->value = value;
-    item->next = NULL;
-    return item;
+    Cson *cson = cson__new(arena);
+    cson->type = Cson_Map;
+    cson->value.map = cson__map_create(arena, count);
+    return cson;
 }
 
-CsonError cson_map_insert(Cson *map, CsonStr key, Cson *value)
+Cson* cson_map_new(void)
 {
-    if (map == NULL || key.value == NULL || value == NULL) return CsonError_InvalidParam;
-    if (map->type != Cson_Map) return CsonError_InvalidType;
-    CsonMap *i_map = cson__to_map(map);
-    size_t index = cson_str_hash(key) % i_map->capacity;
-    CsonMapItem *item = i_map->items[index];
-    if (item != NULL){
-        do {
-            if (cson_str_equals(item->key, key)){
-                item->value = value;
-                return CsonError_Success;
-            }
-            if (item->next == NULL) break;
-            item = item->next;
-        }while(true);
-        item->next = cson_map_item_new(key, value);
-    }
-    else{
-        i_map->items[index] = cson_map_item_new(key, value);
-    }
-    i_map->size++;
-    return CsonError_Success;
+    return cson__map_new(cson_current_arena);
 }
 
-CsonError cson_map_remove(Cson *map, CsonStr key)
+// drops the removed items and rebuilds the table. the table only doubles if the remaining
+// items fill more than half of it, so each rehash frees room for at least as many inserts as it moves
+static void cson__map_rehash(CsonMap *map)
 {
-    if (map == NULL || key.value == NULL) return CsonError_InvalidParam;
-    if (map->type != Cson_Map) return CsonError_InvalidType;
-    CsonMap *i_map = cson__to_map(map);
-    size_t index = cson_str_hash(key) % i_map->capacity;
-    CsonMapItem *item = i_map->items[index];
-    if (item == NULL) return CsonError_KeyError;
-    if (cson_str_equals(item->key, key)){
-        i_map->items[index] = item->next;
-        i_map->size--;
-        return CsonError_Success;
+    size_t used = 0;
+    for (size_t i=0; i<map->used; ++i){
+        if (map->items[i].value != NULL) map->items[used++] = map->items[i];
     }
-    while (item->next != NULL){
-        if (cson_str_equals(item->next->key, key)){
-            item->next = item->next->next;
-            i_map->size--;
-            return CsonError_Success;
-        }
-        item = item->next;
+    map->used = used;
+    size_t item_capacity = cson__map_item_capacity(map->capacity);
+    uint32_t *slots = map->slots;
+    if (map->size > item_capacity/2){
+        size_t new_capacity = map->capacity*2;
+        size_t new_item_capacity = cson__map_item_capacity(new_capacity);
+        map->items = cson_realloc(map->arena, map->items, item_capacity*sizeof(CsonMapItem), new_item_capacity*sizeof(CsonMapItem));
+        slots = cson__alloc(map->arena, new_capacity*sizeof(uint32_t));
+        cson_assert_alloc(slots);
+        cson__release(map->arena, map->slots, map->capacity*sizeof(uint32_t));
+        map->slots = slots;
+        map->capacity = new_capacity;
+    }
+    else{
+        memset(slots, 0, map->capacity*sizeof(uint32_t));
+    }
+    size_t mask = map->capacity-1;
+    for (size_t i=0; i<used; ++i){
+        size_t slot = map->items[i].hash & mask;
+        while (slots[slot] != 0) slot = (slot+1) & mask;
+        slots[slot] = (uint32_t) (i+1);
     }
-    return CsonError_KeyError;
+}
+
+// the first item at or after *index that has not been removed, *index is moved past it
+static CsonMapItem* cson__map_next(CsonMap *map, size_t *index)
+{
+    while (*index < map->used){
+        CsonMapItem *item = &map->items[(*index)++];
+        if (item->value != NULL) return item;
+    }
+    return NULL;
+}
+
+// returns the slot holding key, or the empty slot where it would be inserted
+static size_t cson__map_find(CsonMap *map, CsonStr key, uint32_t hash)
+{
+    size_t mask = map->capacity-1;
+    size_t slot = hash & mask;
+    uint32_t index;
+    while ((index = map->slots[slot]) != 0){
+        CsonMapItem *item = &map->items[index-1];
+        if (item->hash == hash && cson_str_equals(item->key, key)) break;
+        slot = (slot+1) & mask;
+    }
+    return slot;
+}
+
+CsonError cson_map_insert(Cson *map, CsonStr key, Cson *value)
+{
+    if (key.value == NULL) return CsonError_InvalidParam;
+    return cson__map_insert(map, key, cson_str_hash(key), value);
+}
+
+CsonError cson__map_insert(Cson *map, CsonStr key, uint32_t hash, Cson *value)
+{
+    if (map == NULL || key.value == NULL || value == NULL) return CsonError_InvalidParam;
+    if (map->type != Cson_Map) return CsonError_InvalidType;
+    CsonMap *i_map = cson__to_map(map);
+    size_t slot = cson__map_find(i_map, key, hash);
+    if (i_map->slots[slot] != 0){
+        i_map->items[i_map->slots[slot]-1].value = value;
+        return CsonError_Success;
+    }
+    if (i_map->used+1 > cson__map_item_capacity(i_map->capacity)){
+        cson__map_rehash(i_map);
+        slot = cson__map_find(i_map, key, hash);
+    }
+    i_map->items[i_map->used] = (CsonMapItem) {.key=key, .hash=hash, .value=value};
+    i_map->slots[slot] = (uint32_t) ++i_map->used;
+    i_map->size++;
+    return CsonError_Success;
+}
+
+CsonError cson_map_remove(Cson *map, CsonStr key)
+{
+    if (map == NULL || key.value == NULL) return CsonError_InvalidParam;
+    if (map->type != Cson_Map) return CsonError_InvalidType;
+    CsonMap *i_map = cson__to_map(map);
+    size_t slot = cson__map_find(i_map, key, cson_str_hash(key));
+    uint32_t index = i_map->slots[slot];
+    if (index == 0) return CsonError_KeyError;
+    // backward shift deletion keeps every probe sequence intact without tombstones
+    size_t mask = i_map->capacity-1;
+    size_t next = slot;
+    while (true){
+        next = (next+1) & mask;
+        if (i_map->slots[next] == 0) break;
+        size_t home = i_map->items[i_map->slots[next]-1].hash & mask;
+        if (((next-home) & mask) >= ((next-slot) & mask)){
+            i_map->slots[slot] = i_map->slots[next];
+            slot = next;
+        }
+    }
+    i_map->slots[slot] = 0;
+    // the item keeps its place, so the order of the others and their slots stay untouched
+    i_map->items[index-1] = (CsonMapItem) {0};
+    i_map->size--;
+    while (i_map->used > 0 && i_map->items[i_map->used-1].value == NULL) i_map->used--;
+    return CsonError_Success;
 }
 
 Cson* cson_map_get(Cson *map, CsonStr key)
+{
+    if (key.value == NULL) return NULL;
+    return cson__map_get(map, key, cson_str_hash(key));
+}
+
+Cson* cson__map_get(Cson *map, CsonStr key, uint32_t hash)
 {
     if (map == NULL || key.value == NULL) return NULL;
     if (map->type != Cson_Map) return NULL;
     CsonMap *i_map = cson__to_map(map);
-    size_t index = cson_str_hash(key) % i_map->capacity;
-    CsonMapItem *item = i_map->items[index];
-    while (item != NULL){
-        if (cson_str_equals(item->key, key)) return item->value;
-        item = item->next;
-    }
-    return NULL;
+    uint32_t index = i_map->slots[cson__map_find(i_map, key, hash)];
+    return (index != 0)? i_map->items[index-1].value:NULL;
 }
 
 size_t cson_map_memsize(Cson *map)
 {
     if (map == NULL || map->type != Cson_Map) return 0;
     CsonMap *i_map = cson__to_map(map);
-    size_t total = sizeof(CsonMap);
-    for (size_t i=0; i<i_map->capacity; ++i){
-        CsonMapItem *item = i_map->items[i];
-        while (item != NULL){
-            total += (sizeof(CsonMapItem) + cson_str_memsize(item->key) + cson_memsize(item->value));
-            item = item->next;
-        }
+    size_t total = sizeof(CsonMap) + i_map->capacity*sizeof(uint32_t);
+    size_t index = 0;
+    CsonMapItem *item;
+    while ((item = cson__map_next(i_map, &index)) != NULL){
+        total += (sizeof(CsonMapItem) + cson_str_memsize(item->key) + cson_memsize(item->value));
     }
     return total;
 }
@@ -802,13 +1666,12 @@ Cson *cson_map_keys(Cson *map)
 {
     if (map == NULL || map->type != Cson_Map) return NULL;
     CsonMap *i_map = cson__to_map(map);
-    Cson *array = cson_array_new();
-    for (size_t i=0; i<i_map->capacity; ++i){
-        CsonMapItem *item = i_map->items[i];
-        while (item != NULL){
-            cson_array_push(array, cson_new_string(cson_str_dup(item->key)));
-            item = item->next;
-        }
+    Cson *array = cson__array_new_sized(i_map->arena, i_map->size);
+    CsonArray *arr = array->value.array;
+    size_t index = 0;
+    CsonMapItem *item;
+    while ((item = cson__map_next(i_map, &index)) != NULL){
+        cson__set_string(i_map->arena, &arr->head[arr->size++], item->key);
     }
     return array;
 }
@@ -829,6 +1692,21 @@ CsonRegion* cson__new_region(size_t capacity)
 void cson__free(CsonArena *arena)
 {
     if (arena == NULL) return;
+#ifdef CSON__MMAP
+    for (CsonMapping *mapping = arena->mappings; mapping != NULL; mapping = mapping->next){
+        munmap(mapping->data, mapping->size);
+    }
+#endif // CSON__MMAP
+    arena->mappings = NULL;
+    memset(arena->free_lists, 0, sizeof(arena->free_lists));
+    arena->free_mask = 0;
+    free(arena->parse_cache.structurals);
+    free(arena->parse_cache.grammar_stack);
+    free(arena->parse_cache.builder_stack);
+    free(arena->parse_cache.builder_values);
+    arena->parse_cache = (CsonParseCache) {0};
+    free(arena->interned.entries);
+    arena->interned = (CsonInternTable) {0};
     CsonRegion *next = arena->first;
     while (next != NULL){
         CsonRegion *temp = next;
@@ -839,10 +1717,78 @@ void cson__free(CsonArena *arena)
     arena->last = NULL;
 }
 
+// header written into a released block
+typedef struct CsonFreeBlock{
+    struct CsonFreeBlock *next;
+    size_t words;
+} CsonFreeBlock;
+
+#define cson__words(size) (((size) + sizeof(uintptr_t) - 1) / sizeof(uintptr_t))
+
+static inline int cson__log2_floor(size_t n)
+{
+    int log = 0;
+    while (n >>= 1) log++;
+    return log;
+}
+
+static void cson__push_free(CsonArena *arena, uintptr_t *block, size_t words)
+{
+    if (words*sizeof(uintptr_t) < sizeof(CsonFreeBlock)) return;
+    int c = cson__log2_floor(words);
+    CsonFreeBlock *free_block = (CsonFreeBlock*) block;
+    free_block->next = arena->free_lists[c];
+    free_block->words = words;
+    arena->free_lists[c] = free_block;
+    arena->free_mask |= 1ull << c;
+}
+
+// takes a released block of at least words words, the rest is released again
+static void* cson__pop_free(CsonArena *arena, size_t words)
+{
+    int c = (words <= 1)? 0:cson__log2_floor(words-1) + 1;
+    if (c >= CSON_FREE_CLASSES) return NULL;
+    uint64_t classes = arena->free_mask & ~((1ull << c) - 1);
+    if (classes == 0) return NULL;
+    c = 0;
+    while ((classes & 1) == 0){
+        classes >>= 1;
+        c++;
+    }
+    CsonFreeBlock *block = arena->free_lists[c];
+    arena->free_lists[c] = block->next;
+    if (block->next == NULL) arena->free_mask &= ~(1ull << c);
+    size_t block_words = block->words;
+    uintptr_t *data = (uintptr_t*) block;
+    cson__push_free(arena, data + words, block_words - words);
+    // fresh regions are zeroed, so reused blocks are as well
+    memset(data, 0, words*sizeof(uintptr_t));
+    return data;
+}
+
+// hands a block that is no longer used back to the arena for reuse
+void cson__release(CsonArena *arena, void *ptr, size_t size)
+{
+    if (arena == NULL || ptr == NULL) return;
+    size_t words = size / sizeof(uintptr_t);
+    CsonRegion *last = arena->last;
+    // the last allocation is simply undone
+    if (last != NULL && (uintptr_t*) ptr + cson__words(size) == &last->data[last->size]){
+        last->size -= cson__words(size);
+        memset(ptr, 0, cson__words(size)*sizeof(uintptr_t));
+        return;
+    }
+    cson__push_free(arena, ptr, words);
+}
+
 void* cson__alloc(CsonArena *arena, size_t size)
 {
     if (arena == NULL) return NULL;
-    size_t all_size = (size + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+    size_t all_size = cson__words(size);
+    if (arena->free_mask != 0){
+        void *block = cson__pop_free(arena, all_size);
+        if (block != NULL) return block;
+    }
     size_t default_capacity = (arena->region_size != 0)? arena->region_size:CSON_REGION_CAPACITY;
     if (arena->first == NULL){
         cson_assert(arena->last == NULL, "Invalid arena state!: first:%p, last:%p", arena->first, arena->last);
@@ -853,9 +1799,14 @@ void* cson__alloc(CsonArena *arena, size_t size)
     }
     CsonRegion *last = arena->last;
     if (last->size + all_size > last->capacity){
-        cson_assert(arena->last == NULL, "Invalid arena state!: size:%u, capacity:%u, next:%p", last->size, last->capacity, last->next);
-        size_t capacity = (all_size > default_capacity)? all_size:default_capacity;
-        last->next = cson__new_region(capacity);
+        CsonRegion *next = last->next;
+        if (next == NULL || next->capacity < all_size){
+            // retained regions that are too small stay behind the new one
+            size_t capacity = (all_size > default_capacity)? all_size:default_capacity;
+            CsonRegion *region = cson__new_region(capacity);
+            region->next = next;
+            last->next = region;
+        }
         arena->last = last->next;
     }
     void *result = &arena->last->data[arena->last->size];
@@ -863,30 +1814,137 @@ void* cson__alloc(CsonArena *arena, size_t size)
     return result;
 }
 
+CsonArenaMark cson_arena_mark(CsonArena *arena)
+{
+    if (arena == NULL || arena->last == NULL) return (CsonArenaMark) {0};
+    return (CsonArenaMark) {.region=arena->last, .size=arena->last->size, .mappings=arena->mappings};
+}
+
+// frees the retained regions that exceed arena->max_retained
+static void cson__arena_trim(CsonArena *arena)
+{
+    if (arena->max_retained == 0 || arena->last == NULL) return;
+    size_t total = 0;
+    for (CsonRegion *region = arena->first; region != arena->last->next; region = region->next){
+        total += region->capacity*sizeof(uintptr_t);
+    }
+    CsonRegion *prev = arena->last;
+    while (prev->next != NULL){
+        CsonRegion *region = prev->next;
+        size_t bytes = region->capacity*sizeof(uintptr_t);
+        if (total + bytes <= arena->max_retained){
+            total += bytes;
+            prev = region;
+        }
+        else{
+            prev->next = region->next;
+            free(region);
+        }
+    }
+}
+
+// drops everything allocated after mark, the regions are kept for reuse
+void cson_arena_rewind(CsonArena *arena, CsonArenaMark mark)
+{
+    if (arena == NULL || arena->first == NULL) return;
+    // interned keys may lie behind the mark
+    if (arena->interned.count > 0){
+        memset(arena->interned.entries, 0, arena->interned.capacity*sizeof(CsonInternEntry));
+        arena->interned.count = 0;
+        arena->interned.hits = 0;
+    }
+    while (arena->mappings != NULL && arena->mappings != mark.mappings){
+#ifdef CSON__MMAP
+        munmap(arena->mappings->data, arena->mappings->size);
+#endif // CSON__MMAP
+        arena->mappings = arena->mappings->next;
+    }
+    // released blocks may lie behind the mark
+    memset(arena->free_lists, 0, sizeof(arena->free_lists));
+    arena->free_mask = 0;
+    CsonRegion *target = (mark.region != NULL)? mark.region:arena->first;
+    size_t target_size = (mark.region != NULL)? mark.size:0;
+    CsonRegion *end = arena->last->next;
+    for (CsonRegion *region = target; region != end; region = region->next){
+        size_t keep = (region == target)? target_size:0;
+        // keep the memory zeroed like a fresh region
+        if (region->size > keep) memset(&region->data[keep], 0, (region->size - keep)*sizeof(uintptr_t));
+        region->size = keep;
+    }
+    arena->last = target;
+    cson__arena_trim(arena);
+}
+
+// moves all memory of other into arena, other is left empty
+void cson__arena_adopt(CsonArena *arena, CsonArena *other)
+{
+    if (arena == NULL || other == NULL || arena == other) return;
+    free(other->parse_cache.structurals);
+    free(other->parse_cache.grammar_stack);
+    free(other->parse_cache.builder_stack);
+    free(other->parse_cache.builder_values);
+    free(other->interned.entries);
+    if (other->mappings != NULL){
+        CsonMapping *tail = other->mappings;
+        while (tail->next != NULL) tail = tail->next;
+        tail->next = arena->mappings;
+        arena->mappings = other->mappings;
+    }
+    if (other->first != NULL){
+        // spare regions of other are not needed
+        CsonRegion *spare = other->last->next;
+        while (spare != NULL){
+            CsonRegion *next = spare->next;
+            free(spare);
+            spare = next;
+        }
+        // the regions are inserted after the last used one, so marks of arena stay valid
+        if (arena->last == NULL){
+            other->last->next = arena->first;
+            arena->first = other->first;
+        }
+        else{
+            other->last->next = arena->last->next;
+            arena->last->next = other->first;
+        }
+        arena->last = other->last;
+    }
+    *other = (CsonArena) {0};
+}
+
+void cson_arena_reset(CsonArena *arena)
+{
+    cson_arena_rewind(arena, (CsonArenaMark) {0});
+}
+
 void* cson_realloc(CsonArena *arena, void *old_ptr, size_t old_size, size_t new_size)
 {
     if (arena == NULL) return NULL;
+    if (old_ptr == NULL) return cson__alloc(arena, new_size);
     if (old_size >= new_size) return old_ptr;
+    size_t old_words = cson__words(old_size);
+    size_t new_words = cson__words(new_size);
+    CsonRegion *last = arena->last;
+    // the last allocation of the arena grows in place when its region has room
+    if (last != NULL && (uintptr_t*) old_ptr + old_words == &last->data[last->size] && last->size - old_words + new_words <= last->capacity){
+        last->size += new_words - old_words;
+        return old_ptr;
+    }
     void *new_ptr = cson__alloc(arena, new_size);
     cson_assert_alloc(new_ptr);
-    char *rc = (char*) old_ptr;
-    char *wc = (char*) new_ptr;
-    for (size_t i=0; i<old_size; ++i){
-        *wc++ = *rc++;
-    }
+    memcpy(new_ptr, old_ptr, old_size);
+    cson__push_free(arena, old_ptr, old_size / sizeof(uintptr_t));
     return new_ptr;
 }
 
 void* cson_dup(CsonArena *arena, void *old_ptr, size_t old_size, size_t new_size)
 {
     if (arena == NULL) return NULL;
-    void *new_ptr = cson__alloc(arena, new_size);
+    char *new_ptr = cson__alloc(arena, new_size);
     cson_assert_alloc(new_ptr);
-    char *rc = (char*) old_ptr;
-    char *wc = (char*) new_ptr;
-    for (size_t i=0; i<new_size; ++i){
-        *wc++ = (i<old_size)?*rc++:'\0';
-    }
+    size_t copy = (old_size < new_size)? old_size:new_size;
+    memcpy(new_ptr, old_ptr, copy);
+    memset(new_ptr + copy, 0, new_size - copy);
     return new_ptr;
 }
 
@@ -917,14 +1975,112 @@ void cson_free()
 }
 
 /* Further utilities */
+// 64x64 -> 128 bit multiply, the high and low halves are written back to a and b
+static inline void cson__mum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t) *a * *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+#else
+    uint64_t ha = *a >> 32, la = (uint32_t) *a, hb = *b >> 32, lb = (uint32_t) *b;
+    uint64_t rh = ha*hb, rm0 = ha*lb, rm1 = hb*la, rl = la*lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t carry = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    carry += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+static inline uint64_t cson__mix(uint64_t a, uint64_t b)
+{
+    cson__mum(&a, &b);
+    return a ^ b;
+}
+
+// a plain counting loop without early exit, so the compiler vectorizes it
+static size_t cson__count_newlines(char *from, char *to)
+{
+    size_t lines = 0;
+    for (char *p=from; p<to; ++p) lines += (*p == '\n');
+    return lines;
+}
+
+// moves loc from from to to
+static void cson__advance_loc(CsonLoc *loc, char *from, char *to)
+{
+    size_t lines = cson__count_newlines(from, to);
+    if (lines == 0){
+        loc->column += to - from;
+        return;
+    }
+    char *line_start = to;
+    while (line_start[-1] != '\n') line_start--;
+    loc->row += lines;
+    loc->column = to - line_start + 1;
+}
+
+// the location of at, which becomes the origin. a location without an origin is already resolved
+static CsonLoc cson__loc_resolve(CsonLoc loc, char *at)
+{
+    if (loc.origin == NULL || at == NULL || at < loc.origin) return loc;
+    cson__advance_loc(&loc, loc.origin, at);
+    loc.origin = at;
+    return loc;
+}
+
+static inline uint64_t cson__read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t cson__read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
 uint32_t cson_hash(void *p, size_t n)
 {
-    // DJB2 hashing
-    uint32_t hash = 5381;
-    while (n-- > 0){
-        hash = ((hash << 5) + hash) + *((char*)p++);
+    // wyhash-style, consumes 8 or 16 bytes per step
+    const uint64_t s0 = 0xa0761d6478bd642fULL, s1 = 0xe7037ed1a0b428dbULL, s2 = 0x8ebc6af09c88c6e3ULL;
+    const unsigned char *s = p;
+    uint64_t seed = cson__mix(s0 ^ s1, s2);
+    uint64_t a, b;
+    if (n <= 16){
+        if (n >= 4){
+            size_t shift = (n >> 3) << 2;
+            a = (cson__read32(s) << 32) | cson__read32(s+shift);
+            b = (cson__read32(s+n-4) << 32) | cson__read32(s+n-4-shift);
+        }
+        else if (n > 0){
+            a = ((uint64_t) s[0] << 16) | ((uint64_t) s[n >> 1] << 8) | s[n-1];
+            b = 0;
+        }
+        else{
+            a = b = 0;
+        }
+    }
+    else{
+        size_t i = n;
+        while (i > 16){
+            seed = cson__mix(cson__read64(s) ^ s1, cson__read64(s+8) ^ seed);
+            s += 16;
+            i -= 16;
+        }
+        a = cson__read64(s+i-16);
+        b = cson__read64(s+i-8);
     }
-    return hash;
+    a ^= s1;
+    b ^= seed;
+    cson__mum(&a, &b);
+    uint64_t hash = cson__mix(a ^ s0 ^ n, b ^ s1);
+    return (uint32_t) (hash ^ (hash >> 32));
 }
 
 uint64_t cson_file_size(const char* filename){
@@ -950,6 +2106,51 @@ CsonStr cson_str_dup(CsonStr str)
     return (CsonStr) {.value=cson_dup(cson_current_arena, str.value, str.len, str.len+1), .len=str.len};
 }
 
+CsonStr cson_str_intern(CsonStr str)
+{
+    if (str.value == NULL) return str;
+    return cson__str_intern(cson_current_arena, str, cson_str_hash(str));
+}
+
+// returns the interned copy of str, which is added to the table of the arena if needed
+CsonStr cson__str_intern(CsonArena *arena, CsonStr str, uint32_t hash)
+{
+    CsonInternTable *table = &arena->interned;
+    if (table->count*2 >= table->capacity && table->capacity < CSON_INTERN_CAPACITY){
+        size_t capacity = (table->capacity == 0)? 256:table->capacity*2;
+        CsonInternEntry *entries = calloc(capacity, sizeof(*entries));
+        cson_assert_alloc(entries);
+        for (size_t i=0; i<table->capacity; ++i){
+            if (table->entries[i].key.value == NULL) continue;
+            size_t slot = table->entries[i].hash & (capacity-1);
+            while (entries[slot].key.value != NULL) slot = (slot+1) & (capacity-1);
+            entries[slot] = table->entries[i];
+        }
+        free(table->entries);
+        table->entries = entries;
+        table->capacity = capacity;
+    }
+    size_t mask = table->capacity-1;
+    size_t slot = hash & mask;
+    for (CsonInternEntry *entry; (entry = &table->entries[slot])->key.value != NULL; slot = (slot+1) & mask){
+        if (entry->hash == hash && entry->key.len == str.len && memcmp(entry->key.value, str.value, str.len) == 0){
+            table->hits++;
+            return entry->key;
+        }
+    }
+    char *value = cson__alloc(arena, str.len+1);
+    cson_assert_alloc(value);
+    memcpy(value, str.value, str.len);
+    value[str.len] = '\0';
+    CsonStr copy = {.value=value, .len=str.len};
+    // a full table keeps a free half, so lookups always end
+    if (table->count*2 < table->capacity){
+        table->entries[slot] = (CsonInternEntry) {.key=copy, .hash=hash};
+        table->count++;
+    }
+    return copy;
+}
+
 uint32_t cson_str_hash(CsonStr str)
 {
     return cson_hash(str.value, str.len);
@@ -957,14 +2158,9 @@ uint32_t cson_str_hash(CsonStr str)
 
 bool cson_str_equals(CsonStr a, CsonStr b)
 {
-    if (a.len != b.len) return false;
-    char *pa = a.value;
-    char *pb = b.value;
-    size_t len = a.len;
-    while (len-- > 0){
-        if (*pa++ != *pb++) return false;
-    }
-    return true;
+    // interned keys share their bytes
+    if (a.value == b.value) return a.len == b.len;
+    return a.len == b.len && memcmp(a.value, b.value, a.len) == 0;
 }
 
 size_t cson_str_memsize(CsonStr string)
@@ -977,508 +2173,4825 @@ size_t cson_str_memsize(CsonStr string)
 }
 
 
+// escape sequence for every byte that may not appear raw in a json string, 'u' means \u00XX
+static const char cson__escape_table[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    ['"'] = '"', ['\\'] = '\\'
+};
+
+static const char cson__hex_digits[] = "0123456789abcdef";
+
 void cson_escape_string(const char *string, char *buffer, size_t buffer_size)
 {
     if (string == NULL || buffer == NULL || buffer_size == 0) return;
-    size_t ri = 0;
     size_t wi = 0;
-    while (string[ri] != '\0' && wi < buffer_size - 1){
-        char c = string[ri++];
-        if (c == '\\') {
-            if (wi + 2 > buffer_size) break;
-            buffer[wi++] = '\\';
+    for (const char *c=string; *c != '\0'; ++c){
+        char escape = cson__escape_table[(uint8_t) *c];
+        size_t len = (escape == 0)? 1:(escape == 'u')? 6:2;
+        if (wi + len >= buffer_size) break;
+        if (escape == 0){
+            buffer[wi++] = *c;
+        }
+        else if (escape == 'u'){
+            memcpy(buffer + wi, "\\u00", 4);
+            buffer[wi+4] = cson__hex_digits[(uint8_t) *c >> 4];
+            buffer[wi+5] = cson__hex_digits[*c & 0xF];
+            wi += 6;
+        }
+        else{
             buffer[wi++] = '\\';
-        } else {
-            buffer[wi++] = c;
+            buffer[wi++] = escape;
         }
     }
     buffer[wi] = '\0';
 }
 
-#define cson_print_indent(file, indent) (fprintf((file), "%*s", (indent)*CSON_PRINT_INDENT, ""))
+/* Float formatting */
 
-void cson_fprint(Cson *value, FILE *file, size_t indent)
+// Grisu2 (Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers"):
+// the digits always read back as the same double and are the shortest possible in almost all cases
+
+typedef struct{
+    uint64_t f;
+    int e;
+} CsonDiyFp;
+
+// normalized 10^k for k = -348, -340, ..., 340
+static const uint64_t cson__cached_powers_f[] = {
+    0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull, 0xcf42894a5dce35eaull,
+    0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull, 0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full,
+    0xbe5691ef416bd60cull, 0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+    0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull, 0xc21094364dfb5637ull,
+    0x9096ea6f3848984full, 0xd77485cb25823ac7ull, 0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull,
+    0xb23867fb2a35b28eull, 0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+    0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull, 0xb5b5ada8aaff80b8ull,
+    0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull, 0x964e858c91ba2655ull, 0xdff9772470297ebdull,
+    0xa6dfbd9fb8e5b88full, 0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+    0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull, 0xaa242499697392d3ull,
+    0xfd87b5f28300ca0eull, 0xbce5086492111aebull, 0x8cbccc096f5088ccull, 0xd1b71758e219652cull,
+    0x9c40000000000000ull, 0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+    0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull, 0x9f4f2726179a2245ull,
+    0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull, 0x83c7088e1aab65dbull, 0xc45d1df942711d9aull,
+    0x924d692ca61be758ull, 0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+    0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull, 0x952ab45cfa97a0b3ull,
+    0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull, 0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull,
+    0x88fcf317f22241e2ull, 0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+    0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull, 0x8bab8eefb6409c1aull,
+    0xd01fef10a657842cull, 0x9b10a4e5e9913129ull, 0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull,
+    0x80444b5e7aa7cf85ull, 0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+    0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull
+};
+
+static const int16_t cson__cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+
+static const uint64_t cson__pow10_u64[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull,
+    10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull,
+    1000000000000000ull, 10000000000000000ull, 100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+};
+
+static inline int cson__clz64(uint64_t n)
 {
-    if (value == NULL || file == NULL) return;
-    switch (value->type){
-        case Cson_Int:{
-            fprintf(file, "%"PRId64, value->value.integer);
-        }break;
-        case Cson_Float:{
-            fprintf(file, "%lf", value->value.floating);
-        }break;
-        case Cson_Bool:{
-            fprintf(file, "%s", value->value.boolean? "true":"false");
-        }break; 
-        case Cson_String:{
-            cson_escape_string(value->value.string.value, cson_temp_buffer, sizeof(cson_temp_buffer));
-            fprintf(file, "\"%s\"", cson_temp_buffer);
-        }break;
-        case Cson_Null:{
-            fprintf(file, "null");
-        }break;
-        case Cson_Array:{
-            cson_array_fprint(value->value.array, file, indent);
-        }break;
-        case Cson_Map:{
-            cson_map_fprint(value->value.map, file, indent);
-        }break;
-        default:{
-            cson_error(CsonError_InvalidType, "Invalid value type: %s", CsonErrorStrings[value->type]);
-            return;
-        }
+#ifdef __GNUC__
+    return __builtin_clzll(n);
+#else
+    int count = 0;
+    while ((n & (1ull << 63)) == 0){
+        n <<= 1;
+        count++;
     }
+    return count;
+#endif
 }
 
-void cson_array_fprint(CsonArray *array, FILE *file, size_t indent)
+static CsonDiyFp cson__diyfp_mul(CsonDiyFp a, CsonDiyFp b)
 {
-    fprintf(file, "[\n");
-    for (size_t i=0; i<array->size; ++i){
-        cson_print_indent(file, indent+1);
-        cson_fprint(array->items[i], file, indent+1);
-        fprintf(file, "%c\n", (i+1 == array->size)? ' ':',');
-    }
-    cson_print_indent(file, indent);
-    fputc(']', file);
+    const uint64_t mask = 0xFFFFFFFFull;
+    uint64_t a0 = a.f & mask, a1 = a.f >> 32, b0 = b.f & mask, b1 = b.f >> 32;
+    uint64_t p00 = a0*b0, p01 = a0*b1, p10 = a1*b0, p11 = a1*b1;
+    uint64_t mid = (p00 >> 32) + (p10 & mask) + (p01 & mask) + (1ull << 31); // round the lower half
+    return (CsonDiyFp) {.f=p11 + (p10 >> 32) + (p01 >> 32) + (mid >> 32), .e=a.e + b.e + 64};
 }
 
-void cson_map_fprint(CsonMap *map, FILE *file, size_t indent)
+static CsonDiyFp cson__diyfp_normalize(CsonDiyFp x)
 {
-    fprintf(file, "{\n");
-    size_t size = map->size;
-    for (size_t i=0; i<map->capacity; ++i){
-        CsonMapItem *value = map->items[i];
-        while (value){
-            cson_print_indent(file, indent+1);
-            fprintf(file, "\"%s\": ", value->key.value);
-            cson_fprint(value->value, file, indent+1);
-            fprintf(file, "%c\n", (--size > 0)? ',':' ');
-            value = value->next;
-        }
-    }
-    cson_print_indent(file, indent);
-    fputc('}', file);
+    int shift = cson__clz64(x.f);
+    return (CsonDiyFp) {.f=x.f << shift, .e=x.e - shift};
 }
 
-bool cson_write(Cson *json, char *filename)
+static void cson__grisu_round(char *digits, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
 {
-    if (json == NULL || filename == NULL) return false;
-    FILE *file = fopen(filename, "w");
-    if (file == NULL){
-        cson_error(CsonError_FileNotFound, "Could not find file: \"%s\"", filename);
-        return false;
+    while (rest < wp_w && delta - rest >= ten_kappa && (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)){
+        digits[len-1]--;
+        rest += ten_kappa;
     }
-    cson_fprint(json, file, 0);
-    fclose(file);
-    return true;
 }
 
-CsonLexer cson_lex_init(char *buffer, size_t buffer_size, char *filename)
+// writes the shortest digits of the positive, finite value, the result is digits * 10^exponent
+static int cson__grisu2(double value, char *digits, int *exponent)
 {
-    return (CsonLexer) {.buffer=buffer, .buffer_size=buffer_size, .index=0, .loc=(CsonLoc){.filename=filename, .row=1, .column=1}};
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint64_t significand = bits & ((1ull << 52) - 1);
+    int biased = (int) (bits >> 52) & 0x7FF;
+    CsonDiyFp v = (biased != 0)? (CsonDiyFp) {.f=significand | (1ull << 52), .e=biased - 1075}:(CsonDiyFp) {.f=significand, .e=-1074};
+
+    // the boundaries halfway to the neighbouring doubles
+    CsonDiyFp plus = {.f=(v.f << 1) + 1, .e=v.e - 1};
+    plus = cson__diyfp_normalize(plus);
+    CsonDiyFp minus = (v.f == (1ull << 52))? (CsonDiyFp) {.f=(v.f << 2) - 1, .e=v.e - 2}:(CsonDiyFp) {.f=(v.f << 1) - 1, .e=v.e - 1};
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    // scale by a cached power of ten, so the product has its binary exponent in [-60, -32]
+    double dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+    int k = (int) dk;
+    if (dk - k > 0.0) k++;
+    int index = (k >> 3) + 1;
+    int K = -(-348 + index*8);
+    CsonDiyFp c_mk = {.f=cson__cached_powers_f[index], .e=cson__cached_powers_e[index]};
+    CsonDiyFp W = cson__diyfp_mul(cson__diyfp_normalize(v), c_mk);
+    CsonDiyFp Wp = cson__diyfp_mul(plus, c_mk);
+    CsonDiyFp Wm = cson__diyfp_mul(minus, c_mk);
+    Wm.f++;
+    Wp.f--;
+
+    // generate digits of Wp until they are inside the safe interval (Wm, Wp)
+    uint64_t delta = Wp.f - Wm.f;
+    uint64_t wp_w = Wp.f - W.f;
+    int shift = -Wp.e;
+    uint64_t one = 1ull << shift;
+    uint32_t p1 = (uint32_t) (Wp.f >> shift);
+    uint64_t p2 = Wp.f & (one - 1);
+    int kappa = 1;
+    while (kappa < 10 && p1 >= cson__pow10_u64[kappa]) kappa++;
+    int len = 0;
+    while (kappa > 0){
+        uint32_t d = p1 / (uint32_t) cson__pow10_u64[kappa-1];
+        p1 %= (uint32_t) cson__pow10_u64[kappa-1];
+        if (d != 0 || len != 0) digits[len++] = '0' + d;
+        kappa--;
+        uint64_t rest = ((uint64_t) p1 << shift) + p2;
+        if (rest <= delta){
+            *exponent = K + kappa;
+            cson__grisu_round(digits, len, delta, rest, cson__pow10_u64[kappa] << shift, wp_w);
+            return len;
+        }
+    }
+    while (true){
+        p2 *= 10;
+        delta *= 10;
+        char d = (char) (p2 >> shift);
+        if (d != 0 || len != 0) digits[len++] = '0' + d;
+        p2 &= one - 1;
+        kappa--;
+        if (p2 < delta){
+            *exponent = K + kappa;
+            cson__grisu_round(digits, len, delta, p2, one, (-kappa < 20)? wp_w * cson__pow10_u64[-kappa]:0);
+            return len;
+        }
+    }
 }
 
-bool cson_lex_next(CsonLexer *lexer, CsonToken *token)
+// formats a double into out (at least CSON_DTOA_SIZE bytes), the text always reads back as a float
+// json has no representation for nan and infinity, they are written as null
+size_t cson__dtoa(double value, char *out)
 {
-    if (lexer == NULL || token == NULL || lexer->index > lexer->buffer_size) return false;
-    cson_lex_trim_left(lexer);
-    char *t_start = cson_lex_get_pointer(lexer);
-    CsonLoc t_loc = lexer->loc;
-    switch (cson_lex_get_char(lexer)){
-        case '{':{
-            cson_lex_set_token(token, CsonToken_MapOpen, t_start, t_start+1, t_loc);
-            break;
-        }
-        case '}':{
-            cson_lex_set_token(token, CsonToken_MapClose, t_start, t_start+1, t_loc);
-            break;
-        }
-        case '[':{
-            cson_lex_set_token(token, CsonToken_ArrayOpen, t_start, t_start+1, t_loc);
-            break;
-        }
-        case ']':{
-            cson_lex_set_token(token, CsonToken_ArrayClose, t_start, t_start+1, t_loc);
-            break;
-        }
-        case ',':{
-            cson_lex_set_token(token, CsonToken_Sep, t_start, t_start+1, t_loc);
-            break;
-        }
-        case ':':{
-            cson_lex_set_token(token, CsonToken_MapSep, t_start, t_start+1, t_loc);
-            break;
-        }
-        case '"':{
-            // lex string
-            cson_lex_inc(lexer);
-            char *s_start = cson_lex_get_pointer(lexer);
-            if (!cson_lex_find(lexer, '"')){
-                cson_error(CsonError_UnclosedString, "Missing closing delimeter for '\"' at " CSON_LOC_FMT "\n", cson_loc_expand(t_loc));
-                return false;
-            }
-            char *s_end = cson_lex_get_pointer(lexer);
-            cson_lex_set_token(token, CsonToken_String, s_start, s_end, t_loc);
-            break;
-        }
-        case '\0':
-        case EOF:{
-            cson_lex_set_token(token, CsonToken_End, t_start, t_start+1, t_loc);
-            cson_lex_inc(lexer);
-            return false;
+    if (value != value || value - value != 0){
+        memcpy(out, "null", 4);
+        return 4;
+    }
+    char *p = out;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if (bits >> 63){
+        *p++ = '-';
+        value = -value;
+    }
+    if (value == 0.0){
+        memcpy(p, "0.0", 3);
+        return p + 3 - out;
+    }
+    char digits[18];
+    int exponent;
+    int len = cson__grisu2(value, digits, &exponent);
+    // position of the decimal point relative to the first digit
+    int point = len + exponent;
+    if (exponent >= 0 && point <= 21){
+        // 1200 -> 1200.0
+        memcpy(p, digits, len);
+        memset(p + len, '0', exponent);
+        p += point;
+        memcpy(p, ".0", 2);
+        p += 2;
+    }
+    else if (point > 0 && point <= 21){
+        // 12.34
+        memcpy(p, digits, point);
+        p[point] = '.';
+        memcpy(p + point + 1, digits + point, len - point);
+        p += len + 1;
+    }
+    else if (point > -6 && point <= 0){
+        // 0.001234
+        memcpy(p, "0.", 2);
+        memset(p + 2, '0', -point);
+        memcpy(p + 2 - point, digits, len);
+        p += 2 - point + len;
+    }
+    else{
+        // 1.234e-7, 1e300
+        *p++ = digits[0];
+        if (len > 1){
+            *p++ = '.';
+            memcpy(p, digits + 1, len - 1);
+            p += len - 1;
         }
-        default:{
-            // multi-character literal
-            // find end of literal
-            char c;
-            while (lexer->index < lexer->buffer_size && !cson_lex_is_delimeter(c = cson_lex_get_char(lexer))){
-                cson_lex_check_line(lexer, c);
-                lexer->index++;
-            }
-            char *t_end = cson_lex_get_pointer(lexer);
-            size_t t_len = t_end-t_start;
-            // check for known literals
-            if (memcmp(t_start, "true", t_len) == 0){
-                cson_lex_set_token(token, CsonToken_True, t_start, t_end, t_loc);
-                return true;
-            }
-            if (memcmp(t_start, "false", t_len) == 0){
-                cson_lex_set_token(token, CsonToken_False, t_start, t_end, t_loc);
-                return true;
-            }
-            if (memcmp(t_start, "null", t_len) == 0){
-                cson_lex_set_token(token, CsonToken_Null, t_start, t_end, t_loc);
-                return true;
-            }
-            if (cson_lex_is_int(t_start, t_end)){
-                cson_lex_set_token(token, CsonToken_Int, t_start, t_end, t_loc);
-                return true;
-            }
-            if (cson_lex_is_float(t_start, t_end)){
-                cson_lex_set_token(token, CsonToken_Float, t_start, t_end, t_loc);
-                return true;
-            }
-            cson_error(CsonError_InvalidType, "Invalid literal \"%.*s\" at "CSON_LOC_FMT, t_len, t_start, cson_loc_expand(t_loc));
-            cson_lex_set_token(token, CsonToken_Invalid, t_start, t_end, t_loc);
-            return false;
+        *p++ = 'e';
+        int e = point - 1;
+        if (e < 0){
+            *p++ = '-';
+            e = -e;
         }
+        if (e >= 100) *p++ = '0' + e / 100;
+        if (e >= 10) *p++ = '0' + e / 10 % 10;
+        *p++ = '0' + e % 10;
     }
-    cson_lex_inc(lexer);
-    return true;
+    return p - out;
 }
 
-bool cson__lex_expect(CsonLexer *lexer, CsonToken *token, CsonTokenType types[], size_t count, char *file, size_t line)
+/* Serializer implementation */
+
+// makes room for at least size more bytes and returns the write position
+static char* cson__buf_reserve(CsonBuf *buf, size_t size)
 {
-    if (lexer == NULL || token == NULL) return false;
-    cson_lex_next(lexer, token);
-    for (size_t i=0; i<count; ++i){
-        if (token->type == types[i]) return true;
+    if (buf->size + size > buf->capacity){
+        size_t capacity = (buf->capacity == 0)? 256:buf->capacity;
+        while (capacity < buf->size + size) capacity *= 2;
+        char *data = realloc(buf->data, capacity);
+        cson_assert_alloc(data);
+        buf->data = data;
+        buf->capacity = capacity;
     }
-    cson__error_unexpected(token->loc, types, count, token->type, file, line);
-    return false;  
+    return buf->data + buf->size;
 }
 
-bool cson_lex_extract(CsonToken *token, char *buffer, size_t buffer_size)
+static void cson__buf_append(CsonBuf *buf, const char *data, size_t len)
 {
-    if (token == NULL || buffer == NULL || buffer_size == 0) return false;
-    if (token->len >= buffer_size) return false;
-    if (token->type == CsonToken_String){
-        char temp_buffer[token->len+1];
-        memset(temp_buffer, 0, token->len+1);
-        char *r = token->t_start;
-        char *w = temp_buffer;
-        while (r != token->t_end){
-            if (*r == '\\'){
-                switch(*++r){
-                    case '\'': *w = 0x27; break;
-                    case '"':  *w = 0x22; break;
-                    case '?':  *w = 0x3f; break;
-                    case '\\': *w = 0x5c; break;
-                    case 'a':  *w = 0x07; break;
-                    case 'b':  *w = 0x08; break;
-                    case 'f':  *w = 0x0c; break;
-                    case 'n':  *w = 0x0a; break;
-                    case 'r':  *w = 0x0d; break;
-                    case 't':  *w = 0x09; break;
-                    case 'v':  *w = 0x0b; break;
-                    default:{
-                        *w++ = '\\';
-                        *w = *r;
+    memcpy(cson__buf_reserve(buf, len), data, len);
+    buf->size += len;
+}
+
+#define cson__buf_push(buf, c) do{*cson__buf_reserve((buf), 1) = (c); (buf)->size++;}while(0)
+
+void cson_buf_free(CsonBuf *buf)
+{
+    if (buf == NULL) return;
+    free(buf->data);
+    *buf = (CsonBuf) {0};
+}
+
+static void cson__serialize_int(CsonBuf *buf, int64_t value)
+{
+    char digits[20];
+    size_t i = sizeof(digits);
+    uint64_t n = (value < 0)? 0 - (uint64_t) value:(uint64_t) value;
+    do{
+        digits[--i] = '0' + n % 10;
+        n /= 10;
+    }while (n != 0);
+    if (value < 0) cson__buf_push(buf, '-');
+    cson__buf_append(buf, digits + i, sizeof(digits) - i);
+}
+
+static void cson__serialize_float(CsonBuf *buf, double value)
+{
+    buf->size += cson__dtoa(value, cson__buf_reserve(buf, CSON_DTOA_SIZE));
+}
+
+static void cson__serialize_string(CsonBuf *buf, CsonStr str)
+{
+    cson__buf_push(buf, '"');
+    size_t start = 0;
+    for (size_t i=0; i<str.len; ++i){
+        char escape = cson__escape_table[(uint8_t) str.value[i]];
+        if (escape == 0) continue;
+        cson__buf_append(buf, str.value + start, i - start);
+        start = i + 1;
+        if (escape == 'u'){
+            char *out = cson__buf_reserve(buf, 6);
+            memcpy(out, "\\u00", 4);
+            out[4] = cson__hex_digits[(uint8_t) str.value[i] >> 4];
+            out[5] = cson__hex_digits[str.value[i] & 0xF];
+            buf->size += 6;
+        }
+        else{
+            char *out = cson__buf_reserve(buf, 2);
+            out[0] = '\\';
+            out[1] = escape;
+            buf->size += 2;
+        }
+    }
+    cson__buf_append(buf, str.value + start, str.len - start);
+    cson__buf_push(buf, '"');
+}
+
+static void cson__serialize_newline(CsonBuf *buf, size_t indent)
+{
+    char *out = cson__buf_reserve(buf, 1 + indent*CSON_PRINT_INDENT);
+    out[0] = '\n';
+    memset(out + 1, ' ', indent*CSON_PRINT_INDENT);
+    buf->size += 1 + indent*CSON_PRINT_INDENT;
+}
+
+typedef struct{
+    Cson *container;
+    size_t index; // the next item
+    size_t count; // members written so far
+} CsonSerializeFrame;
+
+// containers are walked with a heap stack, so deep trees do not exhaust the C stack
+static CsonError cson__serialize(Cson *cson, CsonBuf *buf, int flags, size_t indent)
+{
+    if (cson == NULL || buf == NULL) return CsonError_InvalidParam;
+    bool pretty = (flags & CsonSerialize_Pretty) != 0;
+    CsonSerializeFrame *stack = NULL;
+    size_t depth = 0, capacity = 0;
+    CsonError result = CsonError_Success;
+    Cson *value = cson;
+    while (true){
+        // write value, containers are opened and continued below
+        switch (value->type){
+            case Cson_Int: cson__serialize_int(buf, value->value.integer); break;
+            case Cson_Float: cson__serialize_float(buf, value->value.floating); break;
+            case Cson_Bool:{
+                if (value->value.boolean) cson__buf_append(buf, "true", 4);
+                else cson__buf_append(buf, "false", 5);
+            }break;
+            case Cson_String: cson__serialize_string(buf, cson__to_string(value)); break;
+            case Cson_Null: cson__buf_append(buf, "null", 4); break;
+            case Cson_Array:
+            case Cson_Map:{
+                bool is_map = value->type == Cson_Map;
+                cson__buf_push(buf, is_map? '{':'[');
+                if (cson_len(value) == 0){
+                    cson__buf_push(buf, is_map? '}':']');
+                    break;
+                }
+                if (depth >= capacity){
+                    capacity = (capacity == 0)? 64:capacity*2;
+                    CsonSerializeFrame *temp = realloc(stack, capacity*sizeof(*stack));
+                    cson_assert_alloc(temp);
+                    stack = temp;
+                }
+                stack[depth++] = (CsonSerializeFrame) {.container=value, .index=0};
+            }break;
+            default:{
+                cson_error(CsonError_InvalidType, "Invalid value type: %d", value->type);
+                result = CsonError_InvalidType;
+                depth = 0;
+            }
+        }
+        // find the next value, closing every finished container on the way
+        value = NULL;
+        while (depth > 0){
+            CsonSerializeFrame *frame = &stack[depth-1];
+            bool is_map = frame->container->type == Cson_Map;
+            if (frame->count == cson_len(frame->container)){
+                depth--;
+                if (pretty) cson__serialize_newline(buf, indent + depth);
+                cson__buf_push(buf, is_map? '}':']');
+                continue;
+            }
+            if (frame->count++ > 0) cson__buf_push(buf, ',');
+            if (pretty) cson__serialize_newline(buf, indent + depth);
+            if (is_map){
+                CsonMapItem *item = cson__map_next(frame->container->value.map, &frame->index);
+                cson__serialize_string(buf, item->key);
+                if (pretty) cson__buf_append(buf, ": ", 2);
+                else cson__buf_push(buf, ':');
+                value = item->value;
+            }
+            else{
+                value = cson__array_at(frame->container->value.array, frame->index++);
+            }
+            break;
+        }
+        if (value == NULL) break;
+    }
+    free(stack);
+    // keep the output terminated without counting the terminator
+    *cson__buf_reserve(buf, 1) = '\0';
+    return result;
+}
+
+CsonError cson_serialize(Cson *cson, CsonBuf *buf, int flags)
+{
+    return cson__serialize(cson, buf, flags, 0);
+}
+
+void cson_fprint(Cson *value, FILE *file, size_t indent)
+{
+    if (value == NULL || file == NULL) return;
+    CsonBuf buf = {0};
+    if (cson__serialize(value, &buf, CsonSerialize_Pretty, indent) == CsonError_Success){
+        fwrite(buf.data, 1, buf.size, file);
+    }
+    cson_buf_free(&buf);
+}
+
+void cson_array_fprint(CsonArray *array, FILE *file, size_t indent)
+{
+    Cson cson = {.type=Cson_Array, .value.array=array};
+    cson_fprint(&cson, file, indent);
+}
+
+void cson_map_fprint(CsonMap *map, FILE *file, size_t indent)
+{
+    Cson cson = {.type=Cson_Map, .value.map=map};
+    cson_fprint(&cson, file, indent);
+}
+
+bool cson_write(Cson *json, char *filename)
+{
+    if (json == NULL || filename == NULL) return false;
+    CsonBuf buf = {0};
+    if (cson_serialize(json, &buf, CsonSerialize_Pretty) != CsonError_Success){
+        cson_buf_free(&buf);
+        return false;
+    }
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL){
+        cson_error(CsonError_FileNotFound, "Could not find file: \"%s\"", filename);
+        cson_buf_free(&buf);
+        return false;
+    }
+    bool result = fwrite(buf.data, 1, buf.size, file) == buf.size;
+    result = (fclose(file) == 0) && result;
+    cson_buf_free(&buf);
+    return result;
+}
+
+CsonLexer cson_lex_init(char *buffer, size_t buffer_size, char *filename)
+{
+    return (CsonLexer) {.buffer=buffer, .buffer_size=buffer_size, .index=0, .loc=(CsonLoc){.filename=filename, .row=1, .column=1}};
+}
+
+/* Structural index */
+
+#if !defined(CSON_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define CSON__SIMD_X86
+    #include <immintrin.h>
+#endif // CSON_NO_SIMD
+
+typedef struct{
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t structural;
+    uint64_t whitespace;
+} CsonBlock;
+
+typedef void (*CsonClassifyFn)(const char *data, CsonBlock *block);
+
+static inline size_t cson__ctz64(uint64_t n)
+{
+#ifdef __GNUC__
+    return (size_t) __builtin_ctzll(n);
+#else
+    size_t count = 0;
+    while ((n & 1) == 0){
+        n >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+static void cson__classify_scalar(const char *data, CsonBlock *block)
+{
+    *block = (CsonBlock) {0};
+    for (size_t i=0; i<64; ++i){
+        uint64_t bit = (uint64_t)1 << i;
+        switch (data[i]){
+            case '"': block->quote |= bit; break;
+            case '\\': block->backslash |= bit; break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ',':
+            case ':': block->structural |= bit; break;
+            case ' ':
+            case '\n':
+            case '\t':
+            case '\r': block->whitespace |= bit; break;
+            default: break;
+        }
+    }
+}
+
+#ifdef CSON__SIMD_X86
+__attribute__((target("sse2")))
+static void cson__classify_sse2(const char *data, CsonBlock *block)
+{
+    *block = (CsonBlock) {0};
+    for (size_t i=0; i<4; ++i){
+        __m128i v = _mm_loadu_si128((const __m128i*) (data + 16*i));
+        // '[' and ']' only differ from '{' and '}' in bit 0x20
+        __m128i bracket = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i structural = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bracket, _mm_set1_epi8('{')), _mm_cmpeq_epi8(bracket, _mm_set1_epi8('}'))),
+                                          _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(',')), _mm_cmpeq_epi8(v, _mm_set1_epi8(':'))));
+        __m128i whitespace = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+                                          _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        size_t shift = 16*i;
+        block->quote |= (uint64_t)(uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << shift;
+        block->backslash |= (uint64_t)(uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << shift;
+        block->structural |= (uint64_t)(uint16_t) _mm_movemask_epi8(structural) << shift;
+        block->whitespace |= (uint64_t)(uint16_t) _mm_movemask_epi8(whitespace) << shift;
+    }
+}
+
+__attribute__((target("avx2")))
+static void cson__classify_avx2(const char *data, CsonBlock *block)
+{
+    *block = (CsonBlock) {0};
+    for (size_t i=0; i<2; ++i){
+        __m256i v = _mm256_loadu_si256((const __m256i*) (data + 32*i));
+        __m256i bracket = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i structural = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bracket, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(bracket, _mm256_set1_epi8('}'))),
+                                             _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(':'))));
+        __m256i whitespace = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))),
+                                             _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        size_t shift = 32*i;
+        block->quote |= (uint64_t)(uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << shift;
+        block->backslash |= (uint64_t)(uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << shift;
+        block->structural |= (uint64_t)(uint32_t) _mm256_movemask_epi8(structural) << shift;
+        block->whitespace |= (uint64_t)(uint32_t) _mm256_movemask_epi8(whitespace) << shift;
+    }
+}
+#endif // CSON__SIMD_X86
+
+static CsonClassifyFn cson__select_classifier(void)
+{
+#ifdef CSON__SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return cson__classify_avx2;
+    if (__builtin_cpu_supports("sse2")) return cson__classify_sse2;
+#endif // CSON__SIMD_X86
+    return cson__classify_scalar;
+}
+
+// bit i is set if character i is preceded by an odd number of backslashes
+static inline uint64_t cson__escaped_mask(uint64_t backslash, uint64_t *carry)
+{
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    uint64_t starts = backslash & ~(backslash << 1);
+    uint64_t even_start_mask = even_bits ^ *carry;
+    uint64_t even_starts = starts & even_start_mask;
+    uint64_t odd_starts = starts & ~even_start_mask;
+    uint64_t even_carries = backslash + even_starts;
+    uint64_t odd_carries = backslash + odd_starts;
+    bool overflow = odd_carries < backslash;
+    odd_carries |= *carry;
+    *carry = overflow? 1:0;
+    uint64_t even_carry_ends = even_carries & ~backslash;
+    uint64_t odd_carry_ends = odd_carries & ~backslash;
+    return (even_carry_ends & ~even_bits) | (odd_carry_ends & even_bits);
+}
+
+static inline uint64_t cson__prefix_xor(uint64_t n)
+{
+    n ^= n << 1;
+    n ^= n << 2;
+    n ^= n << 4;
+    n ^= n << 8;
+    n ^= n << 16;
+    n ^= n << 32;
+    return n;
+}
+
+// indexes the next CSON_INDEX_WINDOW bytes, entries are stored relative to structural_base
+static bool cson__lex_index_window(CsonLexer *lexer)
+{
+    static CSON_THREAD_LOCAL CsonClassifyFn classify = NULL;
+    if (classify == NULL) classify = cson__select_classifier();
+    if (lexer->indexed >= lexer->buffer_size) return false;
+    size_t start = lexer->indexed;
+    size_t end = (lexer->buffer_size - start > CSON_INDEX_WINDOW)? start + CSON_INDEX_WINDOW:lexer->buffer_size;
+    uint64_t escape_carry = lexer->index_carry[0], string_carry = lexer->index_carry[1], literal_carry = lexer->index_carry[2];
+    uint32_t *structurals = lexer->structurals;
+    size_t count = 0;
+    for (size_t base=start; base<end; base+=64){
+        CsonBlock block;
+        if (end - base >= 64){
+            classify(lexer->buffer + base, &block);
+        }
+        else{
+            char padded[64];
+            memset(padded, ' ', sizeof(padded));
+            memcpy(padded, lexer->buffer + base, end - base);
+            classify(padded, &block);
+        }
+        uint64_t quote = block.quote & ~cson__escaped_mask(block.backslash, &escape_carry);
+        uint64_t in_string = cson__prefix_xor(quote) ^ string_carry;
+        string_carry = (uint64_t)((int64_t) in_string >> 63);
+        uint64_t literal = ~(block.structural | block.whitespace | quote | in_string);
+        uint64_t entries = (block.structural & ~in_string) | quote | (literal & ~((literal << 1) | literal_carry));
+        literal_carry = literal >> 63;
+        while (entries != 0){
+            structurals[count++] = (uint32_t) (base - start + cson__ctz64(entries));
+            entries &= entries - 1;
+        }
+    }
+    lexer->index_carry[0] = escape_carry;
+    lexer->index_carry[1] = string_carry;
+    lexer->index_carry[2] = literal_carry;
+    lexer->structural_base = start;
+    lexer->structural_count = count;
+    lexer->structural_index = 0;
+    lexer->indexed = end;
+    return true;
+}
+
+bool cson_lex_index(CsonLexer *lexer)
+{
+    if (lexer == NULL || lexer->buffer == NULL) return false;
+    if (lexer->structurals == NULL){
+        // at most one entry per byte of a window
+        lexer->structurals = malloc(CSON_INDEX_WINDOW*sizeof(*lexer->structurals));
+        if (lexer->structurals == NULL) return false;
+    }
+    lexer->structural_count = 0;
+    lexer->structural_index = 0;
+    lexer->structural_base = lexer->index;
+    lexer->indexed = lexer->index;
+    memset(lexer->index_carry, 0, sizeof(lexer->index_carry));
+    // from here on tokens only record where they start, their row and column are counted when reported
+    lexer->loc = cson__loc_resolve(lexer->loc, cson_lex_get_pointer(lexer));
+    lexer->loc.origin = cson_lex_get_pointer(lexer);
+    return true;
+}
+
+void cson_lex_free(CsonLexer *lexer)
+{
+    if (lexer == NULL) return;
+    free(lexer->structurals);
+    lexer->structurals = NULL;
+    // the byte-wise lexer keeps its location up to date
+    if (lexer->index <= lexer->buffer_size) lexer->loc = cson__loc_resolve(lexer->loc, cson_lex_get_pointer(lexer));
+    lexer->loc.origin = NULL;
+    lexer->structural_count = 0;
+    lexer->structural_index = 0;
+}
+
+// position of the current structural entry, or buffer_size once the buffer is exhausted
+static size_t cson__lex_entry(CsonLexer *lexer)
+{
+    while (lexer->structural_index >= lexer->structural_count){
+        if (!cson__lex_index_window(lexer)) return lexer->buffer_size;
+    }
+    return lexer->structural_base + lexer->structurals[lexer->structural_index];
+}
+
+// move the lexer to the next structural entry at or after the current index
+static void cson__lex_skip_indexed(CsonLexer *lexer)
+{
+    size_t position;
+    while ((position = cson__lex_entry(lexer)) < lexer->index){
+        lexer->structural_index++;
+    }
+    lexer->index = position;
+}
+
+static CsonTokenType cson__lex_scan_literal(char *s, char *e, CsonNumber *number, char **end);
+
+bool cson_lex_next(CsonLexer *lexer, CsonToken *token)
+{
+    if (lexer == NULL || token == NULL || lexer->index > lexer->buffer_size) return false;
+    bool indexed = lexer->structurals != NULL;
+    if (indexed){
+        cson__lex_skip_indexed(lexer);
+    }
+    else{
+        cson_lex_trim_left(lexer);
+    }
+    char *t_start = cson_lex_get_pointer(lexer);
+    CsonLoc t_loc = lexer->loc;
+    if (indexed && lexer->index >= lexer->buffer_size){
+        cson_lex_set_token(token, CsonToken_End, t_start, t_start+1, t_loc);
+        lexer->index++;
+        return false;
+    }
+    switch (cson_lex_get_char(lexer)){
+        case '{':{
+            cson_lex_set_token(token, CsonToken_MapOpen, t_start, t_start+1, t_loc);
+            break;
+        }
+        case '}':{
+            cson_lex_set_token(token, CsonToken_MapClose, t_start, t_start+1, t_loc);
+            break;
+        }
+        case '[':{
+            cson_lex_set_token(token, CsonToken_ArrayOpen, t_start, t_start+1, t_loc);
+            break;
+        }
+        case ']':{
+            cson_lex_set_token(token, CsonToken_ArrayClose, t_start, t_start+1, t_loc);
+            break;
+        }
+        case ',':{
+            cson_lex_set_token(token, CsonToken_Sep, t_start, t_start+1, t_loc);
+            break;
+        }
+        case ':':{
+            cson_lex_set_token(token, CsonToken_MapSep, t_start, t_start+1, t_loc);
+            break;
+        }
+        case '"':{
+            // lex string
+            char *s_start = t_start+1;
+            if (indexed){
+                // the entry following an opening quote is always its closing quote
+                lexer->structural_index++;
+                size_t s_close = cson__lex_entry(lexer);
+                if (s_close >= lexer->buffer_size){
+                    cson_error(CsonError_UnclosedString, "Missing closing delimeter for '\"' at " CSON_LOC_FMT "\n", cson_loc_expand(cson__loc_resolve(t_loc, t_start)));
+                    return false;
+                }
+                lexer->index = s_close;
+                // an in-situ parse may turn escapes into newlines, so the contents are counted before that
+                if (lexer->insitu) lexer->loc = cson__loc_resolve(lexer->loc, cson_lex_get_pointer(lexer));
+            }
+            else{
+                cson_lex_inc(lexer);
+                if (!cson_lex_find_unescaped(lexer, '"')){
+                    cson_error(CsonError_UnclosedString, "Missing closing delimeter for '\"' at " CSON_LOC_FMT "\n", cson_loc_expand(t_loc));
+                    return false;
+                }
+            }
+            char *s_end = cson_lex_get_pointer(lexer);
+            cson_lex_set_token(token, CsonToken_String, s_start, s_end, t_loc);
+            break;
+        }
+        case '\0':
+        case EOF:{
+            cson_lex_set_token(token, CsonToken_End, t_start, t_start+1, t_loc);
+            cson_lex_inc(lexer);
+            return false;
+        }
+        default:{
+            // multi-character literal, it ends where its text stops matching
+            char *b_end = lexer->buffer + lexer->buffer_size;
+            char *t_end;
+            CsonTokenType type = cson__lex_scan_literal(t_start, b_end, &token->number, &t_end);
+            bool valid = type != CsonToken_Invalid && (t_end == b_end || cson_lex_is_delimeter(*t_end));
+            // only an invalid literal is scanned to its end, to report all of it
+            if (!valid) while (t_end < b_end && !cson_lex_is_delimeter(*t_end)) t_end++;
+            lexer->index = t_end - lexer->buffer;
+            // literals never contain a newline, so only the column moves
+            if (!indexed) lexer->loc.column += t_end-t_start;
+            cson_lex_set_token(token, valid? type:CsonToken_Invalid, t_start, t_end, t_loc);
+            if (!valid){
+                cson_error(CsonError_InvalidType, "Invalid literal \"%.*s\" at "CSON_LOC_FMT, (int) (t_end-t_start), t_start, cson_loc_expand(cson__loc_resolve(t_loc, t_start)));
+                return false;
+            }
+            return true;
+        }
+    }
+    lexer->index++;
+    if (!indexed) lexer->loc.column++;
+    return true;
+}
+
+// classifies the literal between t_start and t_end, numbers are converted into token->number
+CsonTokenType cson__lex_literal(CsonToken *token)
+{
+    char *t_start = token->t_start;
+    if (token->len == 4 && memcmp(t_start, "true", 4) == 0) return token->type = CsonToken_True;
+    if (token->len == 5 && memcmp(t_start, "false", 5) == 0) return token->type = CsonToken_False;
+    if (token->len == 4 && memcmp(t_start, "null", 4) == 0) return token->type = CsonToken_Null;
+    return token->type = cson__lex_number(t_start, token->t_end, &token->number);
+}
+
+// powers of ten that are exact doubles
+static const double cson__pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define CSON__POW10_128_MIN (-348)
+#define CSON__POW10_128_MAX 347
+
+// 10^k for k = -348..347 normalized to 128 bits and rounded down, as {high, low}
+static const uint64_t cson__pow10_128[][2] = {
+    {0xfa8fd5a0081c0288ull, 0x1732c869cd60e453ull}, {0x9c99e58405118195ull, 0x0e7fbd42205c8eb4ull},
+    {0xc3c05ee50655e1faull, 0x521fac92a873b261ull}, {0xf4b0769e47eb5a78ull, 0xe6a797b752909ef9ull},
+    {0x98ee4a22ecf3188bull, 0x9028bed2939a635cull}, {0xbf29dcaba82fdeaeull, 0x7432ee873880fc33ull},
+    {0xeef453d6923bd65aull, 0x113faa2906a13b3full}, {0x9558b4661b6565f8ull, 0x4ac7ca59a424c507ull},
+    {0xbaaee17fa23ebf76ull, 0x5d79bcf00d2df649ull}, {0xe95a99df8ace6f53ull, 0xf4d82c2c107973dcull},
+    {0x91d8a02bb6c10594ull, 0x79071b9b8a4be869ull}, {0xb64ec836a47146f9ull, 0x9748e2826cdee284ull},
+    {0xe3e27a444d8d98b7ull, 0xfd1b1b2308169b25ull}, {0x8e6d8c6ab0787f72ull, 0xfe30f0f5e50e20f7ull},
+    {0xb208ef855c969f4full, 0xbdbd2d335e51a935ull}, {0xde8b2b66b3bc4723ull, 0xad2c788035e61382ull},
+    {0x8b16fb203055ac76ull, 0x4c3bcb5021afcc31ull}, {0xaddcb9e83c6b1793ull, 0xdf4abe242a1bbf3dull},
+    {0xd953e8624b85dd78ull, 0xd71d6dad34a2af0dull}, {0x87d4713d6f33aa6bull, 0x8672648c40e5ad68ull},
+    {0xa9c98d8ccb009506ull, 0x680efdaf511f18c2ull}, {0xd43bf0effdc0ba48ull, 0x0212bd1b2566def2ull},
+    {0x84a57695fe98746dull, 0x014bb630f7604b57ull}, {0xa5ced43b7e3e9188ull, 0x419ea3bd35385e2dull},
+    {0xcf42894a5dce35eaull, 0x52064cac828675b9ull}, {0x818995ce7aa0e1b2ull, 0x7343efebd1940993ull},
+    {0xa1ebfb4219491a1full, 0x1014ebe6c5f90bf8ull}, {0xca66fa129f9b60a6ull, 0xd41a26e077774ef6ull},
+    {0xfd00b897478238d0ull, 0x8920b098955522b4ull}, {0x9e20735e8cb16382ull, 0x55b46e5f5d5535b0ull},
+    {0xc5a890362fddbc62ull, 0xeb2189f734aa831dull}, {0xf712b443bbd52b7bull, 0xa5e9ec7501d523e4ull},
+    {0x9a6bb0aa55653b2dull, 0x47b233c92125366eull}, {0xc1069cd4eabe89f8ull, 0x999ec0bb696e840aull},
+    {0xf148440a256e2c76ull, 0xc00670ea43ca250dull}, {0x96cd2a865764dbcaull, 0x380406926a5e5728ull},
+    {0xbc807527ed3e12bcull, 0xc605083704f5ecf2ull}, {0xeba09271e88d976bull, 0xf7864a44c633682eull},
+    {0x93445b8731587ea3ull, 0x7ab3ee6afbe0211dull}, {0xb8157268fdae9e4cull, 0x5960ea05bad82964ull},
+    {0xe61acf033d1a45dfull, 0x6fb92487298e33bdull}, {0x8fd0c16206306babull, 0xa5d3b6d479f8e056ull},
+    {0xb3c4f1ba87bc8696ull, 0x8f48a4899877186cull}, {0xe0b62e2929aba83cull, 0x331acdabfe94de87ull},
+    {0x8c71dcd9ba0b4925ull, 0x9ff0c08b7f1d0b14ull}, {0xaf8e5410288e1b6full, 0x07ecf0ae5ee44dd9ull},
+    {0xdb71e91432b1a24aull, 0xc9e82cd9f69d6150ull}, {0x892731ac9faf056eull, 0xbe311c083a225cd2ull},
+    {0xab70fe17c79ac6caull, 0x6dbd630a48aaf406ull}, {0xd64d3d9db981787dull, 0x092cbbccdad5b108ull},
+    {0x85f0468293f0eb4eull, 0x25bbf56008c58ea5ull}, {0xa76c582338ed2621ull, 0xaf2af2b80af6f24eull},
+    {0xd1476e2c07286faaull, 0x1af5af660db4aee1ull}, {0x82cca4db847945caull, 0x50d98d9fc890ed4dull},
+    {0xa37fce126597973cull, 0xe50ff107bab528a0ull}, {0xcc5fc196fefd7d0cull, 0x1e53ed49a96272c8ull},
+    {0xff77b1fcbebcdc4full, 0x25e8e89c13bb0f7aull}, {0x9faacf3df73609b1ull, 0x77b191618c54e9acull},
+    {0xc795830d75038c1dull, 0xd59df5b9ef6a2417ull}, {0xf97ae3d0d2446f25ull, 0x4b0573286b44ad1dull},
+    {0x9becce62836ac577ull, 0x4ee367f9430aec32ull}, {0xc2e801fb244576d5ull, 0x229c41f793cda73full},
+    {0xf3a20279ed56d48aull, 0x6b43527578c1110full}, {0x9845418c345644d6ull, 0x830a13896b78aaa9ull},
+    {0xbe5691ef416bd60cull, 0x23cc986bc656d553ull}, {0xedec366b11c6cb8full, 0x2cbfbe86b7ec8aa8ull},
+    {0x94b3a202eb1c3f39ull, 0x7bf7d71432f3d6a9ull}, {0xb9e08a83a5e34f07ull, 0xdaf5ccd93fb0cc53ull},
+    {0xe858ad248f5c22c9ull, 0xd1b3400f8f9cff68ull}, {0x91376c36d99995beull, 0x23100809b9c21fa1ull},
+    {0xb58547448ffffb2dull, 0xabd40a0c2832a78aull}, {0xe2e69915b3fff9f9ull, 0x16c90c8f323f516cull},
+    {0x8dd01fad907ffc3bull, 0xae3da7d97f6792e3ull}, {0xb1442798f49ffb4aull, 0x99cd11cfdf41779cull},
+    {0xdd95317f31c7fa1dull, 0x40405643d711d583ull}, {0x8a7d3eef7f1cfc52ull, 0x482835ea666b2572ull},
+    {0xad1c8eab5ee43b66ull, 0xda3243650005eecfull}, {0xd863b256369d4a40ull, 0x90bed43e40076a82ull},
+    {0x873e4f75e2224e68ull, 0x5a7744a6e804a291ull}, {0xa90de3535aaae202ull, 0x711515d0a205cb36ull},
+    {0xd3515c2831559a83ull, 0x0d5a5b44ca873e03ull}, {0x8412d9991ed58091ull, 0xe858790afe9486c2ull},
+    {0xa5178fff668ae0b6ull, 0x626e974dbe39a872ull}, {0xce5d73ff402d98e3ull, 0xfb0a3d212dc8128full},
+    {0x80fa687f881c7f8eull, 0x7ce66634bc9d0b99ull}, {0xa139029f6a239f72ull, 0x1c1fffc1ebc44e80ull},
+    {0xc987434744ac874eull, 0xa327ffb266b56220ull}, {0xfbe9141915d7a922ull, 0x4bf1ff9f0062baa8ull},
+    {0x9d71ac8fada6c9b5ull, 0x6f773fc3603db4a9ull}, {0xc4ce17b399107c22ull, 0xcb550fb4384d21d3ull},
+    {0xf6019da07f549b2bull, 0x7e2a53a146606a48ull}, {0x99c102844f94e0fbull, 0x2eda7444cbfc426dull},
+    {0xc0314325637a1939ull, 0xfa911155fefb5308ull}, {0xf03d93eebc589f88ull, 0x793555ab7eba27caull},
+    {0x96267c7535b763b5ull, 0x4bc1558b2f3458deull}, {0xbbb01b9283253ca2ull, 0x9eb1aaedfb016f16ull},
+    {0xea9c227723ee8bcbull, 0x465e15a979c1cadcull}, {0x92a1958a7675175full, 0x0bfacd89ec191ec9ull},
+    {0xb749faed14125d36ull, 0xcef980ec671f667bull}, {0xe51c79a85916f484ull, 0x82b7e12780e7401aull},
+    {0x8f31cc0937ae58d2ull, 0xd1b2ecb8b0908810ull}, {0xb2fe3f0b8599ef07ull, 0x861fa7e6dcb4aa15ull},
+    {0xdfbdcece67006ac9ull, 0x67a791e093e1d49aull}, {0x8bd6a141006042bdull, 0xe0c8bb2c5c6d24e0ull},
+    {0xaecc49914078536dull, 0x58fae9f773886e18ull}, {0xda7f5bf590966848ull, 0xaf39a475506a899eull},
+    {0x888f99797a5e012dull, 0x6d8406c952429603ull}, {0xaab37fd7d8f58178ull, 0xc8e5087ba6d33b83ull},
+    {0xd5605fcdcf32e1d6ull, 0xfb1e4a9a90880a64ull}, {0x855c3be0a17fcd26ull, 0x5cf2eea09a55067full},
+    {0xa6b34ad8c9dfc06full, 0xf42faa48c0ea481eull}, {0xd0601d8efc57b08bull, 0xf13b94daf124da26ull},
+    {0x823c12795db6ce57ull, 0x76c53d08d6b70858ull}, {0xa2cb1717b52481edull, 0x54768c4b0c64ca6eull},
+    {0xcb7ddcdda26da268ull, 0xa9942f5dcf7dfd09ull}, {0xfe5d54150b090b02ull, 0xd3f93b35435d7c4cull},
+    {0x9efa548d26e5a6e1ull, 0xc47bc5014a1a6dafull}, {0xc6b8e9b0709f109aull, 0x359ab6419ca1091bull},
+    {0xf867241c8cc6d4c0ull, 0xc30163d203c94b62ull}, {0x9b407691d7fc44f8ull, 0x79e0de63425dcf1dull},
+    {0xc21094364dfb5636ull, 0x985915fc12f542e4ull}, {0xf294b943e17a2bc4ull, 0x3e6f5b7b17b2939dull},
+    {0x979cf3ca6cec5b5aull, 0xa705992ceecf9c42ull}, {0xbd8430bd08277231ull, 0x50c6ff782a838353ull},
+    {0xece53cec4a314ebdull, 0xa4f8bf5635246428ull}, {0x940f4613ae5ed136ull, 0x871b7795e136be99ull},
+    {0xb913179899f68584ull, 0x28e2557b59846e3full}, {0xe757dd7ec07426e5ull, 0x331aeada2fe589cfull},
+    {0x9096ea6f3848984full, 0x3ff0d2c85def7621ull}, {0xb4bca50b065abe63ull, 0x0fed077a756b53a9ull},
+    {0xe1ebce4dc7f16dfbull, 0xd3e8495912c62894ull}, {0x8d3360f09cf6e4bdull, 0x64712dd7abbbd95cull},
+    {0xb080392cc4349decull, 0xbd8d794d96aacfb3ull}, {0xdca04777f541c567ull, 0xecf0d7a0fc5583a0ull},
+    {0x89e42caaf9491b60ull, 0xf41686c49db57244ull}, {0xac5d37d5b79b6239ull, 0x311c2875c522ced5ull},
+    {0xd77485cb25823ac7ull, 0x7d633293366b828bull}, {0x86a8d39ef77164bcull, 0xae5dff9c02033197ull},
+    {0xa8530886b54dbdebull, 0xd9f57f830283fdfcull}, {0xd267caa862a12d66ull, 0xd072df63c324fd7bull},
+    {0x8380dea93da4bc60ull, 0x4247cb9e59f71e6dull}, {0xa46116538d0deb78ull, 0x52d9be85f074e608ull},
+    {0xcd795be870516656ull, 0x67902e276c921f8bull}, {0x806bd9714632dff6ull, 0x00ba1cd8a3db53b6ull},
+    {0xa086cfcd97bf97f3ull, 0x80e8a40eccd228a4ull}, {0xc8a883c0fdaf7df0ull, 0x6122cd128006b2cdull},
+    {0xfad2a4b13d1b5d6cull, 0x796b805720085f81ull}, {0x9cc3a6eec6311a63ull, 0xcbe3303674053bb0ull},
+    {0xc3f490aa77bd60fcull, 0xbedbfc4411068a9cull}, {0xf4f1b4d515acb93bull, 0xee92fb5515482d44ull},
+    {0x991711052d8bf3c5ull, 0x751bdd152d4d1c4aull}, {0xbf5cd54678eef0b6ull, 0xd262d45a78a0635dull},
+    {0xef340a98172aace4ull, 0x86fb897116c87c34ull}, {0x9580869f0e7aac0eull, 0xd45d35e6ae3d4da0ull},
+    {0xbae0a846d2195712ull, 0x8974836059cca109ull}, {0xe998d258869facd7ull, 0x2bd1a438703fc94bull},
+    {0x91ff83775423cc06ull, 0x7b6306a34627ddcfull}, {0xb67f6455292cbf08ull, 0x1a3bc84c17b1d542ull},
+    {0xe41f3d6a7377eecaull, 0x20caba5f1d9e4a93ull}, {0x8e938662882af53eull, 0x547eb47b7282ee9cull},
+    {0xb23867fb2a35b28dull, 0xe99e619a4f23aa43ull}, {0xdec681f9f4c31f31ull, 0x6405fa00e2ec94d4ull},
+    {0x8b3c113c38f9f37eull, 0xde83bc408dd3dd04ull}, {0xae0b158b4738705eull, 0x9624ab50b148d445ull},
+    {0xd98ddaee19068c76ull, 0x3badd624dd9b0957ull}, {0x87f8a8d4cfa417c9ull, 0xe54ca5d70a80e5d6ull},
+    {0xa9f6d30a038d1dbcull, 0x5e9fcf4ccd211f4cull}, {0xd47487cc8470652bull, 0x7647c3200069671full},
+    {0x84c8d4dfd2c63f3bull, 0x29ecd9f40041e073ull}, {0xa5fb0a17c777cf09ull, 0xf468107100525890ull},
+    {0xcf79cc9db955c2ccull, 0x7182148d4066eeb4ull}, {0x81ac1fe293d599bfull, 0xc6f14cd848405530ull},
+    {0xa21727db38cb002full, 0xb8ada00e5a506a7cull}, {0xca9cf1d206fdc03bull, 0xa6d90811f0e4851cull},
+    {0xfd442e4688bd304aull, 0x908f4a166d1da663ull}, {0x9e4a9cec15763e2eull, 0x9a598e4e043287feull},
+    {0xc5dd44271ad3cdbaull, 0x40eff1e1853f29fdull}, {0xf7549530e188c128ull, 0xd12bee59e68ef47cull},
+    {0x9a94dd3e8cf578b9ull, 0x82bb74f8301958ceull}, {0xc13a148e3032d6e7ull, 0xe36a52363c1faf01ull},
+    {0xf18899b1bc3f8ca1ull, 0xdc44e6c3cb279ac1ull}, {0x96f5600f15a7b7e5ull, 0x29ab103a5ef8c0b9ull},
+    {0xbcb2b812db11a5deull, 0x7415d448f6b6f0e7ull}, {0xebdf661791d60f56ull, 0x111b495b3464ad21ull},
+    {0x936b9fcebb25c995ull, 0xcab10dd900beec34ull}, {0xb84687c269ef3bfbull, 0x3d5d514f40eea742ull},
+    {0xe65829b3046b0afaull, 0x0cb4a5a3112a5112ull}, {0x8ff71a0fe2c2e6dcull, 0x47f0e785eaba72abull},
+    {0xb3f4e093db73a093ull, 0x59ed216765690f56ull}, {0xe0f218b8d25088b8ull, 0x306869c13ec3532cull},
+    {0x8c974f7383725573ull, 0x1e414218c73a13fbull}, {0xafbd2350644eeacfull, 0xe5d1929ef90898faull},
+    {0xdbac6c247d62a583ull, 0xdf45f746b74abf39ull}, {0x894bc396ce5da772ull, 0x6b8bba8c328eb783ull},
+    {0xab9eb47c81f5114full, 0x066ea92f3f326564ull}, {0xd686619ba27255a2ull, 0xc80a537b0efefebdull},
+    {0x8613fd0145877585ull, 0xbd06742ce95f5f36ull}, {0xa798fc4196e952e7ull, 0x2c48113823b73704ull},
+    {0xd17f3b51fca3a7a0ull, 0xf75a15862ca504c5ull}, {0x82ef85133de648c4ull, 0x9a984d73dbe722fbull},
+    {0xa3ab66580d5fdaf5ull, 0xc13e60d0d2e0ebbaull}, {0xcc963fee10b7d1b3ull, 0x318df905079926a8ull},
+    {0xffbbcfe994e5c61full, 0xfdf17746497f7052ull}, {0x9fd561f1fd0f9bd3ull, 0xfeb6ea8bedefa633ull},
+    {0xc7caba6e7c5382c8ull, 0xfe64a52ee96b8fc0ull}, {0xf9bd690a1b68637bull, 0x3dfdce7aa3c673b0ull},
+    {0x9c1661a651213e2dull, 0x06bea10ca65c084eull}, {0xc31bfa0fe5698db8ull, 0x486e494fcff30a62ull},
+    {0xf3e2f893dec3f126ull, 0x5a89dba3c3efccfaull}, {0x986ddb5c6b3a76b7ull, 0xf89629465a75e01cull},
+    {0xbe89523386091465ull, 0xf6bbb397f1135823ull}, {0xee2ba6c0678b597full, 0x746aa07ded582e2cull},
+    {0x94db483840b717efull, 0xa8c2a44eb4571cdcull}, {0xba121a4650e4ddebull, 0x92f34d62616ce413ull},
+    {0xe896a0d7e51e1566ull, 0x77b020baf9c81d17ull}, {0x915e2486ef32cd60ull, 0x0ace1474dc1d122eull},
+    {0xb5b5ada8aaff80b8ull, 0x0d819992132456baull}, {0xe3231912d5bf60e6ull, 0x10e1fff697ed6c69ull},
+    {0x8df5efabc5979c8full, 0xca8d3ffa1ef463c1ull}, {0xb1736b96b6fd83b3ull, 0xbd308ff8a6b17cb2ull},
+    {0xddd0467c64bce4a0ull, 0xac7cb3f6d05ddbdeull}, {0x8aa22c0dbef60ee4ull, 0x6bcdf07a423aa96bull},
+    {0xad4ab7112eb3929dull, 0x86c16c98d2c953c6ull}, {0xd89d64d57a607744ull, 0xe871c7bf077ba8b7ull},
+    {0x87625f056c7c4a8bull, 0x11471cd764ad4972ull}, {0xa93af6c6c79b5d2dull, 0xd598e40d3dd89bcfull},
+    {0xd389b47879823479ull, 0x4aff1d108d4ec2c3ull}, {0x843610cb4bf160cbull, 0xcedf722a585139baull},
+    {0xa54394fe1eedb8feull, 0xc2974eb4ee658828ull}, {0xce947a3da6a9273eull, 0x733d226229feea32ull},
+    {0x811ccc668829b887ull, 0x0806357d5a3f525full}, {0xa163ff802a3426a8ull, 0xca07c2dcb0cf26f7ull},
+    {0xc9bcff6034c13052ull, 0xfc89b393dd02f0b5ull}, {0xfc2c3f3841f17c67ull, 0xbbac2078d443ace2ull},
+    {0x9d9ba7832936edc0ull, 0xd54b944b84aa4c0dull}, {0xc5029163f384a931ull, 0x0a9e795e65d4df11ull},
+    {0xf64335bcf065d37dull, 0x4d4617b5ff4a16d5ull}, {0x99ea0196163fa42eull, 0x504bced1bf8e4e45ull},
+    {0xc06481fb9bcf8d39ull, 0xe45ec2862f71e1d6ull}, {0xf07da27a82c37088ull, 0x5d767327bb4e5a4cull},
+    {0x964e858c91ba2655ull, 0x3a6a07f8d510f86full}, {0xbbe226efb628afeaull, 0x890489f70a55368bull},
+    {0xeadab0aba3b2dbe5ull, 0x2b45ac74ccea842eull}, {0x92c8ae6b464fc96full, 0x3b0b8bc90012929dull},
+    {0xb77ada0617e3bbcbull, 0x09ce6ebb40173744ull}, {0xe55990879ddcaabdull, 0xcc420a6a101d0515ull},
+    {0x8f57fa54c2a9eab6ull, 0x9fa946824a12232dull}, {0xb32df8e9f3546564ull, 0x47939822dc96abf9ull},
+    {0xdff9772470297ebdull, 0x59787e2b93bc56f7ull}, {0x8bfbea76c619ef36ull, 0x57eb4edb3c55b65aull},
+    {0xaefae51477a06b03ull, 0xede622920b6b23f1ull}, {0xdab99e59958885c4ull, 0xe95fab368e45ecedull},
+    {0x88b402f7fd75539bull, 0x11dbcb0218ebb414ull}, {0xaae103b5fcd2a881ull, 0xd652bdc29f26a119ull},
+    {0xd59944a37c0752a2ull, 0x4be76d3346f0495full}, {0x857fcae62d8493a5ull, 0x6f70a4400c562ddbull},
+    {0xa6dfbd9fb8e5b88eull, 0xcb4ccd500f6bb952ull}, {0xd097ad07a71f26b2ull, 0x7e2000a41346a7a7ull},
+    {0x825ecc24c873782full, 0x8ed400668c0c28c8ull}, {0xa2f67f2dfa90563bull, 0x728900802f0f32faull},
+    {0xcbb41ef979346bcaull, 0x4f2b40a03ad2ffb9ull}, {0xfea126b7d78186bcull, 0xe2f610c84987bfa8ull},
+    {0x9f24b832e6b0f436ull, 0x0dd9ca7d2df4d7c9ull}, {0xc6ede63fa05d3143ull, 0x91503d1c79720dbbull},
+    {0xf8a95fcf88747d94ull, 0x75a44c6397ce912aull}, {0x9b69dbe1b548ce7cull, 0xc986afbe3ee11abaull},
+    {0xc24452da229b021bull, 0xfbe85badce996168ull}, {0xf2d56790ab41c2a2ull, 0xfae27299423fb9c3ull},
+    {0x97c560ba6b0919a5ull, 0xdccd879fc967d41aull}, {0xbdb6b8e905cb600full, 0x5400e987bbc1c920ull},
+    {0xed246723473e3813ull, 0x290123e9aab23b68ull}, {0x9436c0760c86e30bull, 0xf9a0b6720aaf6521ull},
+    {0xb94470938fa89bceull, 0xf808e40e8d5b3e69ull}, {0xe7958cb87392c2c2ull, 0xb60b1d1230b20e04ull},
+    {0x90bd77f3483bb9b9ull, 0xb1c6f22b5e6f48c2ull}, {0xb4ecd5f01a4aa828ull, 0x1e38aeb6360b1af3ull},
+    {0xe2280b6c20dd5232ull, 0x25c6da63c38de1b0ull}, {0x8d590723948a535full, 0x579c487e5a38ad0eull},
+    {0xb0af48ec79ace837ull, 0x2d835a9df0c6d851ull}, {0xdcdb1b2798182244ull, 0xf8e431456cf88e65ull},
+    {0x8a08f0f8bf0f156bull, 0x1b8e9ecb641b58ffull}, {0xac8b2d36eed2dac5ull, 0xe272467e3d222f3full},
+    {0xd7adf884aa879177ull, 0x5b0ed81dcc6abb0full}, {0x86ccbb52ea94baeaull, 0x98e947129fc2b4e9ull},
+    {0xa87fea27a539e9a5ull, 0x3f2398d747b36224ull}, {0xd29fe4b18e88640eull, 0x8eec7f0d19a03aadull},
+    {0x83a3eeeef9153e89ull, 0x1953cf68300424acull}, {0xa48ceaaab75a8e2bull, 0x5fa8c3423c052dd7ull},
+    {0xcdb02555653131b6ull, 0x3792f412cb06794dull}, {0x808e17555f3ebf11ull, 0xe2bbd88bbee40bd0ull},
+    {0xa0b19d2ab70e6ed6ull, 0x5b6aceaeae9d0ec4ull}, {0xc8de047564d20a8bull, 0xf245825a5a445275ull},
+    {0xfb158592be068d2eull, 0xeed6e2f0f0d56712ull}, {0x9ced737bb6c4183dull, 0x55464dd69685606bull},
+    {0xc428d05aa4751e4cull, 0xaa97e14c3c26b886ull}, {0xf53304714d9265dfull, 0xd53dd99f4b3066a8ull},
+    {0x993fe2c6d07b7fabull, 0xe546a8038efe4029ull}, {0xbf8fdb78849a5f96ull, 0xde98520472bdd033ull},
+    {0xef73d256a5c0f77cull, 0x963e66858f6d4440ull}, {0x95a8637627989aadull, 0xdde7001379a44aa8ull},
+    {0xbb127c53b17ec159ull, 0x5560c018580d5d52ull}, {0xe9d71b689dde71afull, 0xaab8f01e6e10b4a6ull},
+    {0x9226712162ab070dull, 0xcab3961304ca70e8ull}, {0xb6b00d69bb55c8d1ull, 0x3d607b97c5fd0d22ull},
+    {0xe45c10c42a2b3b05ull, 0x8cb89a7db77c506aull}, {0x8eb98a7a9a5b04e3ull, 0x77f3608e92adb242ull},
+    {0xb267ed1940f1c61cull, 0x55f038b237591ed3ull}, {0xdf01e85f912e37a3ull, 0x6b6c46dec52f6688ull},
+    {0x8b61313bbabce2c6ull, 0x2323ac4b3b3da015ull}, {0xae397d8aa96c1b77ull, 0xabec975e0a0d081aull},
+    {0xd9c7dced53c72255ull, 0x96e7bd358c904a21ull}, {0x881cea14545c7575ull, 0x7e50d64177da2e54ull},
+    {0xaa242499697392d2ull, 0xdde50bd1d5d0b9e9ull}, {0xd4ad2dbfc3d07787ull, 0x955e4ec64b44e864ull},
+    {0x84ec3c97da624ab4ull, 0xbd5af13bef0b113eull}, {0xa6274bbdd0fadd61ull, 0xecb1ad8aeacdd58eull},
+    {0xcfb11ead453994baull, 0x67de18eda5814af2ull}, {0x81ceb32c4b43fcf4ull, 0x80eacf948770ced7ull},
+    {0xa2425ff75e14fc31ull, 0xa1258379a94d028dull}, {0xcad2f7f5359a3b3eull, 0x096ee45813a04330ull},
+    {0xfd87b5f28300ca0dull, 0x8bca9d6e188853fcull}, {0x9e74d1b791e07e48ull, 0x775ea264cf55347dull},
+    {0xc612062576589ddaull, 0x95364afe032a819dull}, {0xf79687aed3eec551ull, 0x3a83ddbd83f52204ull},
+    {0x9abe14cd44753b52ull, 0xc4926a9672793542ull}, {0xc16d9a0095928a27ull, 0x75b7053c0f178293ull},
+    {0xf1c90080baf72cb1ull, 0x5324c68b12dd6338ull}, {0x971da05074da7beeull, 0xd3f6fc16ebca5e03ull},
+    {0xbce5086492111aeaull, 0x88f4bb1ca6bcf584ull}, {0xec1e4a7db69561a5ull, 0x2b31e9e3d06c32e5ull},
+    {0x9392ee8e921d5d07ull, 0x3aff322e62439fcfull}, {0xb877aa3236a4b449ull, 0x09befeb9fad487c2ull},
+    {0xe69594bec44de15bull, 0x4c2ebe687989a9b3ull}, {0x901d7cf73ab0acd9ull, 0x0f9d37014bf60a10ull},
+    {0xb424dc35095cd80full, 0x538484c19ef38c94ull}, {0xe12e13424bb40e13ull, 0x2865a5f206b06fb9ull},
+    {0x8cbccc096f5088cbull, 0xf93f87b7442e45d3ull}, {0xafebff0bcb24aafeull, 0xf78f69a51539d748ull},
+    {0xdbe6fecebdedd5beull, 0xb573440e5a884d1bull}, {0x89705f4136b4a597ull, 0x31680a88f8953030ull},
+    {0xabcc77118461cefcull, 0xfdc20d2b36ba7c3dull}, {0xd6bf94d5e57a42bcull, 0x3d32907604691b4cull},
+    {0x8637bd05af6c69b5ull, 0xa63f9a49c2c1b10full}, {0xa7c5ac471b478423ull, 0x0fcf80dc33721d53ull},
+    {0xd1b71758e219652bull, 0xd3c36113404ea4a8ull}, {0x83126e978d4fdf3bull, 0x645a1cac083126e9ull},
+    {0xa3d70a3d70a3d70aull, 0x3d70a3d70a3d70a3ull}, {0xccccccccccccccccull, 0xccccccccccccccccull},
+    {0x8000000000000000ull, 0x0000000000000000ull}, {0xa000000000000000ull, 0x0000000000000000ull},
+    {0xc800000000000000ull, 0x0000000000000000ull}, {0xfa00000000000000ull, 0x0000000000000000ull},
+    {0x9c40000000000000ull, 0x0000000000000000ull}, {0xc350000000000000ull, 0x0000000000000000ull},
+    {0xf424000000000000ull, 0x0000000000000000ull}, {0x9896800000000000ull, 0x0000000000000000ull},
+    {0xbebc200000000000ull, 0x0000000000000000ull}, {0xee6b280000000000ull, 0x0000000000000000ull},
+    {0x9502f90000000000ull, 0x0000000000000000ull}, {0xba43b74000000000ull, 0x0000000000000000ull},
+    {0xe8d4a51000000000ull, 0x0000000000000000ull}, {0x9184e72a00000000ull, 0x0000000000000000ull},
+    {0xb5e620f480000000ull, 0x0000000000000000ull}, {0xe35fa931a0000000ull, 0x0000000000000000ull},
+    {0x8e1bc9bf04000000ull, 0x0000000000000000ull}, {0xb1a2bc2ec5000000ull, 0x0000000000000000ull},
+    {0xde0b6b3a76400000ull, 0x0000000000000000ull}, {0x8ac7230489e80000ull, 0x0000000000000000ull},
+    {0xad78ebc5ac620000ull, 0x0000000000000000ull}, {0xd8d726b7177a8000ull, 0x0000000000000000ull},
+    {0x878678326eac9000ull, 0x0000000000000000ull}, {0xa968163f0a57b400ull, 0x0000000000000000ull},
+    {0xd3c21bcecceda100ull, 0x0000000000000000ull}, {0x84595161401484a0ull, 0x0000000000000000ull},
+    {0xa56fa5b99019a5c8ull, 0x0000000000000000ull}, {0xcecb8f27f4200f3aull, 0x0000000000000000ull},
+    {0x813f3978f8940984ull, 0x4000000000000000ull}, {0xa18f07d736b90be5ull, 0x5000000000000000ull},
+    {0xc9f2c9cd04674edeull, 0xa400000000000000ull}, {0xfc6f7c4045812296ull, 0x4d00000000000000ull},
+    {0x9dc5ada82b70b59dull, 0xf020000000000000ull}, {0xc5371912364ce305ull, 0x6c28000000000000ull},
+    {0xf684df56c3e01bc6ull, 0xc732000000000000ull}, {0x9a130b963a6c115cull, 0x3c7f400000000000ull},
+    {0xc097ce7bc90715b3ull, 0x4b9f100000000000ull}, {0xf0bdc21abb48db20ull, 0x1e86d40000000000ull},
+    {0x96769950b50d88f4ull, 0x1314448000000000ull}, {0xbc143fa4e250eb31ull, 0x17d955a000000000ull},
+    {0xeb194f8e1ae525fdull, 0x5dcfab0800000000ull}, {0x92efd1b8d0cf37beull, 0x5aa1cae500000000ull},
+    {0xb7abc627050305adull, 0xf14a3d9e40000000ull}, {0xe596b7b0c643c719ull, 0x6d9ccd05d0000000ull},
+    {0x8f7e32ce7bea5c6full, 0xe4820023a2000000ull}, {0xb35dbf821ae4f38bull, 0xdda2802c8a800000ull},
+    {0xe0352f62a19e306eull, 0xd50b2037ad200000ull}, {0x8c213d9da502de45ull, 0x4526f422cc340000ull},
+    {0xaf298d050e4395d6ull, 0x9670b12b7f410000ull}, {0xdaf3f04651d47b4cull, 0x3c0cdd765f114000ull},
+    {0x88d8762bf324cd0full, 0xa5880a69fb6ac800ull}, {0xab0e93b6efee0053ull, 0x8eea0d047a457a00ull},
+    {0xd5d238a4abe98068ull, 0x72a4904598d6d880ull}, {0x85a36366eb71f041ull, 0x47a6da2b7f864750ull},
+    {0xa70c3c40a64e6c51ull, 0x999090b65f67d924ull}, {0xd0cf4b50cfe20765ull, 0xfff4b4e3f741cf6dull},
+    {0x82818f1281ed449full, 0xbff8f10e7a8921a4ull}, {0xa321f2d7226895c7ull, 0xaff72d52192b6a0dull},
+    {0xcbea6f8ceb02bb39ull, 0x9bf4f8a69f764490ull}, {0xfee50b7025c36a08ull, 0x02f236d04753d5b4ull},
+    {0x9f4f2726179a2245ull, 0x01d762422c946590ull}, {0xc722f0ef9d80aad6ull, 0x424d3ad2b7b97ef5ull},
+    {0xf8ebad2b84e0d58bull, 0xd2e0898765a7deb2ull}, {0x9b934c3b330c8577ull, 0x63cc55f49f88eb2full},
+    {0xc2781f49ffcfa6d5ull, 0x3cbf6b71c76b25fbull}, {0xf316271c7fc3908aull, 0x8bef464e3945ef7aull},
+    {0x97edd871cfda3a56ull, 0x97758bf0e3cbb5acull}, {0xbde94e8e43d0c8ecull, 0x3d52eeed1cbea317ull},
+    {0xed63a231d4c4fb27ull, 0x4ca7aaa863ee4bddull}, {0x945e455f24fb1cf8ull, 0x8fe8caa93e74ef6aull},
+    {0xb975d6b6ee39e436ull, 0xb3e2fd538e122b44ull}, {0xe7d34c64a9c85d44ull, 0x60dbbca87196b616ull},
+    {0x90e40fbeea1d3a4aull, 0xbc8955e946fe31cdull}, {0xb51d13aea4a488ddull, 0x6babab6398bdbe41ull},
+    {0xe264589a4dcdab14ull, 0xc696963c7eed2dd1ull}, {0x8d7eb76070a08aecull, 0xfc1e1de5cf543ca2ull},
+    {0xb0de65388cc8ada8ull, 0x3b25a55f43294bcbull}, {0xdd15fe86affad912ull, 0x49ef0eb713f39ebeull},
+    {0x8a2dbf142dfcc7abull, 0x6e3569326c784337ull}, {0xacb92ed9397bf996ull, 0x49c2c37f07965404ull},
+    {0xd7e77a8f87daf7fbull, 0xdc33745ec97be906ull}, {0x86f0ac99b4e8dafdull, 0x69a028bb3ded71a3ull},
+    {0xa8acd7c0222311bcull, 0xc40832ea0d68ce0cull}, {0xd2d80db02aabd62bull, 0xf50a3fa490c30190ull},
+    {0x83c7088e1aab65dbull, 0x792667c6da79e0faull}, {0xa4b8cab1a1563f52ull, 0x577001b891185938ull},
+    {0xcde6fd5e09abcf26ull, 0xed4c0226b55e6f86ull}, {0x80b05e5ac60b6178ull, 0x544f8158315b05b4ull},
+    {0xa0dc75f1778e39d6ull, 0x696361ae3db1c721ull}, {0xc913936dd571c84cull, 0x03bc3a19cd1e38e9ull},
+    {0xfb5878494ace3a5full, 0x04ab48a04065c723ull}, {0x9d174b2dcec0e47bull, 0x62eb0d64283f9c76ull},
+    {0xc45d1df942711d9aull, 0x3ba5d0bd324f8394ull}, {0xf5746577930d6500ull, 0xca8f44ec7ee36479ull},
+    {0x9968bf6abbe85f20ull, 0x7e998b13cf4e1ecbull}, {0xbfc2ef456ae276e8ull, 0x9e3fedd8c321a67eull},
+    {0xefb3ab16c59b14a2ull, 0xc5cfe94ef3ea101eull}, {0x95d04aee3b80ece5ull, 0xbba1f1d158724a12ull},
+    {0xbb445da9ca61281full, 0x2a8a6e45ae8edc97ull}, {0xea1575143cf97226ull, 0xf52d09d71a3293bdull},
+    {0x924d692ca61be758ull, 0x593c2626705f9c56ull}, {0xb6e0c377cfa2e12eull, 0x6f8b2fb00c77836cull},
+    {0xe498f455c38b997aull, 0x0b6dfb9c0f956447ull}, {0x8edf98b59a373fecull, 0x4724bd4189bd5eacull},
+    {0xb2977ee300c50fe7ull, 0x58edec91ec2cb657ull}, {0xdf3d5e9bc0f653e1ull, 0x2f2967b66737e3edull},
+    {0x8b865b215899f46cull, 0xbd79e0d20082ee74ull}, {0xae67f1e9aec07187ull, 0xecd8590680a3aa11ull},
+    {0xda01ee641a708de9ull, 0xe80e6f4820cc9495ull}, {0x884134fe908658b2ull, 0x3109058d147fdcddull},
+    {0xaa51823e34a7eedeull, 0xbd4b46f0599fd415ull}, {0xd4e5e2cdc1d1ea96ull, 0x6c9e18ac7007c91aull},
+    {0x850fadc09923329eull, 0x03e2cf6bc604ddb0ull}, {0xa6539930bf6bff45ull, 0x84db8346b786151cull},
+    {0xcfe87f7cef46ff16ull, 0xe612641865679a63ull}, {0x81f14fae158c5f6eull, 0x4fcb7e8f3f60c07eull},
+    {0xa26da3999aef7749ull, 0xe3be5e330f38f09dull}, {0xcb090c8001ab551cull, 0x5cadf5bfd3072cc5ull},
+    {0xfdcb4fa002162a63ull, 0x73d9732fc7c8f7f6ull}, {0x9e9f11c4014dda7eull, 0x2867e7fddcdd9afaull},
+    {0xc646d63501a1511dull, 0xb281e1fd541501b8ull}, {0xf7d88bc24209a565ull, 0x1f225a7ca91a4226ull},
+    {0x9ae757596946075full, 0x3375788de9b06958ull}, {0xc1a12d2fc3978937ull, 0x0052d6b1641c83aeull},
+    {0xf209787bb47d6b84ull, 0xc0678c5dbd23a49aull}, {0x9745eb4d50ce6332ull, 0xf840b7ba963646e0ull},
+    {0xbd176620a501fbffull, 0xb650e5a93bc3d898ull}, {0xec5d3fa8ce427affull, 0xa3e51f138ab4cebeull},
+    {0x93ba47c980e98cdfull, 0xc66f336c36b10137ull}, {0xb8a8d9bbe123f017ull, 0xb80b0047445d4184ull},
+    {0xe6d3102ad96cec1dull, 0xa60dc059157491e5ull}, {0x9043ea1ac7e41392ull, 0x87c89837ad68db2full},
+    {0xb454e4a179dd1877ull, 0x29babe4598c311fbull}, {0xe16a1dc9d8545e94ull, 0xf4296dd6fef3d67aull},
+    {0x8ce2529e2734bb1dull, 0x1899e4a65f58660cull}, {0xb01ae745b101e9e4ull, 0x5ec05dcff72e7f8full},
+    {0xdc21a1171d42645dull, 0x76707543f4fa1f73ull}, {0x899504ae72497ebaull, 0x6a06494a791c53a8ull},
+    {0xabfa45da0edbde69ull, 0x0487db9d17636892ull}, {0xd6f8d7509292d603ull, 0x45a9d2845d3c42b6ull},
+    {0x865b86925b9bc5c2ull, 0x0b8a2392ba45a9b2ull}, {0xa7f26836f282b732ull, 0x8e6cac7768d7141eull},
+    {0xd1ef0244af2364ffull, 0x3207d795430cd926ull}, {0x8335616aed761f1full, 0x7f44e6bd49e807b8ull},
+    {0xa402b9c5a8d3a6e7ull, 0x5f16206c9c6209a6ull}, {0xcd036837130890a1ull, 0x36dba887c37a8c0full},
+    {0x802221226be55a64ull, 0xc2494954da2c9789ull}, {0xa02aa96b06deb0fdull, 0xf2db9baa10b7bd6cull},
+    {0xc83553c5c8965d3dull, 0x6f92829494e5acc7ull}, {0xfa42a8b73abbf48cull, 0xcb772339ba1f17f9ull},
+    {0x9c69a97284b578d7ull, 0xff2a760414536efbull}, {0xc38413cf25e2d70dull, 0xfef5138519684abaull},
+    {0xf46518c2ef5b8cd1ull, 0x7eb258665fc25d69ull}, {0x98bf2f79d5993802ull, 0xef2f773ffbd97a61ull},
+    {0xbeeefb584aff8603ull, 0xaafb550ffacfd8faull}, {0xeeaaba2e5dbf6784ull, 0x95ba2a53f983cf38ull},
+    {0x952ab45cfa97a0b2ull, 0xdd945a747bf26183ull}, {0xba756174393d88dfull, 0x94f971119aeef9e4ull},
+    {0xe912b9d1478ceb17ull, 0x7a37cd5601aab85dull}, {0x91abb422ccb812eeull, 0xac62e055c10ab33aull},
+    {0xb616a12b7fe617aaull, 0x577b986b314d6009ull}, {0xe39c49765fdf9d94ull, 0xed5a7e85fda0b80bull},
+    {0x8e41ade9fbebc27dull, 0x14588f13be847307ull}, {0xb1d219647ae6b31cull, 0x596eb2d8ae258fc8ull},
+    {0xde469fbd99a05fe3ull, 0x6fca5f8ed9aef3bbull}, {0x8aec23d680043beeull, 0x25de7bb9480d5854ull},
+    {0xada72ccc20054ae9ull, 0xaf561aa79a10ae6aull}, {0xd910f7ff28069da4ull, 0x1b2ba1518094da04ull},
+    {0x87aa9aff79042286ull, 0x90fb44d2f05d0842ull}, {0xa99541bf57452b28ull, 0x353a1607ac744a53ull},
+    {0xd3fa922f2d1675f2ull, 0x42889b8997915ce8ull}, {0x847c9b5d7c2e09b7ull, 0x69956135febada11ull},
+    {0xa59bc234db398c25ull, 0x43fab9837e699095ull}, {0xcf02b2c21207ef2eull, 0x94f967e45e03f4bbull},
+    {0x8161afb94b44f57dull, 0x1d1be0eebac278f5ull}, {0xa1ba1ba79e1632dcull, 0x6462d92a69731732ull},
+    {0xca28a291859bbf93ull, 0x7d7b8f7503cfdcfeull}, {0xfcb2cb35e702af78ull, 0x5cda735244c3d43eull},
+    {0x9defbf01b061adabull, 0x3a0888136afa64a7ull}, {0xc56baec21c7a1916ull, 0x088aaa1845b8fdd0ull},
+    {0xf6c69a72a3989f5bull, 0x8aad549e57273d45ull}, {0x9a3c2087a63f6399ull, 0x36ac54e2f678864bull},
+    {0xc0cb28a98fcf3c7full, 0x84576a1bb416a7ddull}, {0xf0fdf2d3f3c30b9full, 0x656d44a2a11c51d5ull},
+    {0x969eb7c47859e743ull, 0x9f644ae5a4b1b325ull}, {0xbc4665b596706114ull, 0x873d5d9f0dde1feeull},
+    {0xeb57ff22fc0c7959ull, 0xa90cb506d155a7eaull}, {0x9316ff75dd87cbd8ull, 0x09a7f12442d588f2ull},
+    {0xb7dcbf5354e9beceull, 0x0c11ed6d538aeb2full}, {0xe5d3ef282a242e81ull, 0x8f1668c8a86da5faull},
+    {0x8fa475791a569d10ull, 0xf96e017d694487bcull}, {0xb38d92d760ec4455ull, 0x37c981dcc395a9acull},
+    {0xe070f78d3927556aull, 0x85bbe253f47b1417ull}, {0x8c469ab843b89562ull, 0x93956d7478ccec8eull},
+    {0xaf58416654a6babbull, 0x387ac8d1970027b2ull}, {0xdb2e51bfe9d0696aull, 0x06997b05fcc0319eull},
+    {0x88fcf317f22241e2ull, 0x441fece3bdf81f03ull}, {0xab3c2fddeeaad25aull, 0xd527e81cad7626c3ull},
+    {0xd60b3bd56a5586f1ull, 0x8a71e223d8d3b074ull}, {0x85c7056562757456ull, 0xf6872d5667844e49ull},
+    {0xa738c6bebb12d16cull, 0xb428f8ac016561dbull}, {0xd106f86e69d785c7ull, 0xe13336d701beba52ull},
+    {0x82a45b450226b39cull, 0xecc0024661173473ull}, {0xa34d721642b06084ull, 0x27f002d7f95d0190ull},
+    {0xcc20ce9bd35c78a5ull, 0x31ec038df7b441f4ull}, {0xff290242c83396ceull, 0x7e67047175a15271ull},
+    {0x9f79a169bd203e41ull, 0x0f0062c6e984d386ull}, {0xc75809c42c684dd1ull, 0x52c07b78a3e60868ull},
+    {0xf92e0c3537826145ull, 0xa7709a56ccdf8a82ull}, {0x9bbcc7a142b17ccbull, 0x88a66076400bb691ull},
+    {0xc2abf989935ddbfeull, 0x6acff893d00ea435ull}, {0xf356f7ebf83552feull, 0x0583f6b8c4124d43ull},
+    {0x98165af37b2153deull, 0xc3727a337a8b704aull}, {0xbe1bf1b059e9a8d6ull, 0x744f18c0592e4c5cull},
+    {0xeda2ee1c7064130cull, 0x1162def06f79df73ull}, {0x9485d4d1c63e8be7ull, 0x8addcb5645ac2ba8ull},
+    {0xb9a74a0637ce2ee1ull, 0x6d953e2bd7173692ull}, {0xe8111c87c5c1ba99ull, 0xc8fa8db6ccdd0437ull},
+    {0x910ab1d4db9914a0ull, 0x1d9c9892400a22a2ull}, {0xb54d5e4a127f59c8ull, 0x2503beb6d00cab4bull},
+    {0xe2a0b5dc971f303aull, 0x2e44ae64840fd61dull}, {0x8da471a9de737e24ull, 0x5ceaecfed289e5d2ull},
+    {0xb10d8e1456105dadull, 0x7425a83e872c5f47ull}, {0xdd50f1996b947518ull, 0xd12f124e28f77719ull},
+    {0x8a5296ffe33cc92full, 0x82bd6b70d99aaa6full}, {0xace73cbfdc0bfb7bull, 0x636cc64d1001550bull},
+    {0xd8210befd30efa5aull, 0x3c47f7e05401aa4eull}, {0x8714a775e3e95c78ull, 0x65acfaec34810a71ull},
+    {0xa8d9d1535ce3b396ull, 0x7f1839a741a14d0dull}, {0xd31045a8341ca07cull, 0x1ede48111209a050ull},
+    {0x83ea2b892091e44dull, 0x934aed0aab460432ull}, {0xa4e4b66b68b65d60ull, 0xf81da84d5617853full},
+    {0xce1de40642e3f4b9ull, 0x36251260ab9d668eull}, {0x80d2ae83e9ce78f3ull, 0xc1d72b7c6b426019ull},
+    {0xa1075a24e4421730ull, 0xb24cf65b8612f81full}, {0xc94930ae1d529cfcull, 0xdee033f26797b627ull},
+    {0xfb9b7cd9a4a7443cull, 0x169840ef017da3b1ull}, {0x9d412e0806e88aa5ull, 0x8e1f289560ee864eull},
+    {0xc491798a08a2ad4eull, 0xf1a6f2bab92a27e2ull}, {0xf5b5d7ec8acb58a2ull, 0xae10af696774b1dbull},
+    {0x9991a6f3d6bf1765ull, 0xacca6da1e0a8ef29ull}, {0xbff610b0cc6edd3full, 0x17fd090a58d32af3ull},
+    {0xeff394dcff8a948eull, 0xddfc4b4cef07f5b0ull}, {0x95f83d0a1fb69cd9ull, 0x4abdaf101564f98eull},
+    {0xbb764c4ca7a4440full, 0x9d6d1ad41abe37f1ull}, {0xea53df5fd18d5513ull, 0x84c86189216dc5edull},
+    {0x92746b9be2f8552cull, 0x32fd3cf5b4e49bb4ull}, {0xb7118682dbb66a77ull, 0x3fbc8c33221dc2a1ull},
+    {0xe4d5e82392a40515ull, 0x0fabaf3feaa5334aull}, {0x8f05b1163ba6832dull, 0x29cb4d87f2a7400eull},
+    {0xb2c71d5bca9023f8ull, 0x743e20e9ef511012ull}, {0xdf78e4b2bd342cf6ull, 0x914da9246b255416ull},
+    {0x8bab8eefb6409c1aull, 0x1ad089b6c2f7548eull}, {0xae9672aba3d0c320ull, 0xa184ac2473b529b1ull},
+    {0xda3c0f568cc4f3e8ull, 0xc9e5d72d90a2741eull}, {0x8865899617fb1871ull, 0x7e2fa67c7a658892ull},
+    {0xaa7eebfb9df9de8dull, 0xddbb901b98feeab7ull}, {0xd51ea6fa85785631ull, 0x552a74227f3ea565ull},
+    {0x8533285c936b35deull, 0xd53a88958f87275full}, {0xa67ff273b8460356ull, 0x8a892abaf368f137ull},
+    {0xd01fef10a657842cull, 0x2d2b7569b0432d85ull}, {0x8213f56a67f6b29bull, 0x9c3b29620e29fc73ull},
+    {0xa298f2c501f45f42ull, 0x8349f3ba91b47b8full}, {0xcb3f2f7642717713ull, 0x241c70a936219a73ull},
+    {0xfe0efb53d30dd4d7ull, 0xed238cd383aa0110ull}, {0x9ec95d1463e8a506ull, 0xf4363804324a40aaull},
+    {0xc67bb4597ce2ce48ull, 0xb143c6053edcd0d5ull}, {0xf81aa16fdc1b81daull, 0xdd94b7868e94050aull},
+    {0x9b10a4e5e9913128ull, 0xca7cf2b4191c8326ull}, {0xc1d4ce1f63f57d72ull, 0xfd1c2f611f63a3f0ull},
+    {0xf24a01a73cf2dccfull, 0xbc633b39673c8cecull}, {0x976e41088617ca01ull, 0xd5be0503e085d813ull},
+    {0xbd49d14aa79dbc82ull, 0x4b2d8644d8a74e18ull}, {0xec9c459d51852ba2ull, 0xddf8e7d60ed1219eull},
+    {0x93e1ab8252f33b45ull, 0xcabb90e5c942b503ull}, {0xb8da1662e7b00a17ull, 0x3d6a751f3b936243ull},
+    {0xe7109bfba19c0c9dull, 0x0cc512670a783ad4ull}, {0x906a617d450187e2ull, 0x27fb2b80668b24c5ull},
+    {0xb484f9dc9641e9daull, 0xb1f9f660802dedf6ull}, {0xe1a63853bbd26451ull, 0x5e7873f8a0396973ull},
+    {0x8d07e33455637eb2ull, 0xdb0b487b6423e1e8ull}, {0xb049dc016abc5e5full, 0x91ce1a9a3d2cda62ull},
+    {0xdc5c5301c56b75f7ull, 0x7641a140cc7810fbull}, {0x89b9b3e11b6329baull, 0xa9e904c87fcb0a9dull},
+    {0xac2820d9623bf429ull, 0x546345fa9fbdcd44ull}, {0xd732290fbacaf133ull, 0xa97c177947ad4095ull},
+    {0x867f59a9d4bed6c0ull, 0x49ed8eabcccc485dull}, {0xa81f301449ee8c70ull, 0x5c68f256bfff5a74ull},
+    {0xd226fc195c6a2f8cull, 0x73832eec6fff3111ull}, {0x83585d8fd9c25db7ull, 0xc831fd53c5ff7eabull},
+    {0xa42e74f3d032f525ull, 0xba3e7ca8b77f5e55ull}, {0xcd3a1230c43fb26full, 0x28ce1bd2e55f35ebull},
+    {0x80444b5e7aa7cf85ull, 0x7980d163cf5b81b3ull}, {0xa0555e361951c366ull, 0xd7e105bcc332621full},
+    {0xc86ab5c39fa63440ull, 0x8dd9472bf3fefaa7ull}, {0xfa856334878fc150ull, 0xb14f98f6f0feb951ull},
+    {0x9c935e00d4b9d8d2ull, 0x6ed1bf9a569f33d3ull}, {0xc3b8358109e84f07ull, 0x0a862f80ec4700c8ull},
+    {0xf4a642e14c6262c8ull, 0xcd27bb612758c0faull}, {0x98e7e9cccfbd7dbdull, 0x8038d51cb897789cull},
+    {0xbf21e44003acdd2cull, 0xe0470a63e6bd56c3ull}, {0xeeea5d5004981478ull, 0x1858ccfce06cac74ull},
+    {0x95527a5202df0ccbull, 0x0f37801e0c43ebc8ull}, {0xbaa718e68396cffdull, 0xd30560258f54e6baull},
+    {0xe950df20247c83fdull, 0x47c6b82ef32a2069ull}, {0x91d28b7416cdd27eull, 0x4cdc331d57fa5441ull},
+    {0xb6472e511c81471dull, 0xe0133fe4adf8e952ull}, {0xe3d8f9e563a198e5ull, 0x58180fddd97723a6ull},
+    {0x8e679c2f5e44ff8full, 0x570f09eaa7ea7648ull}, {0xb201833b35d63f73ull, 0x2cd2cc6551e513daull},
+    {0xde81e40a034bcf4full, 0xf8077f7ea65e58d1ull}, {0x8b112e86420f6191ull, 0xfb04afaf27faf782ull},
+    {0xadd57a27d29339f6ull, 0x79c5db9af1f9b563ull}, {0xd94ad8b1c7380874ull, 0x18375281ae7822bcull},
+    {0x87cec76f1c830548ull, 0x8f2293910d0b15b5ull}, {0xa9c2794ae3a3c69aull, 0xb2eb3875504ddb22ull},
+    {0xd433179d9c8cb841ull, 0x5fa60692a46151ebull}, {0x849feec281d7f328ull, 0xdbc7c41ba6bcd333ull},
+    {0xa5c7ea73224deff3ull, 0x12b9b522906c0800ull}, {0xcf39e50feae16befull, 0xd768226b34870a00ull},
+    {0x81842f29f2cce375ull, 0xe6a1158300d46640ull}, {0xa1e53af46f801c53ull, 0x60495ae3c1097fd0ull},
+    {0xca5e89b18b602368ull, 0x385bb19cb14bdfc4ull}, {0xfcf62c1dee382c42ull, 0x46729e03dd9ed7b5ull},
+    {0x9e19db92b4e31ba9ull, 0x6c07a2c26a8346d1ull}, {0xc5a05277621be293ull, 0xc7098b7305241885ull},
+    {0xf70867153aa2db38ull, 0xb8cbee4fc66d1ea7ull}, {0x9a65406d44a5c903ull, 0x737f74f1dc043328ull},
+    {0xc0fe908895cf3b44ull, 0x505f522e53053ff2ull}, {0xf13e34aabb430a15ull, 0x647726b9e7c68fefull},
+    {0x96c6e0eab509e64dull, 0x5eca783430dc19f5ull}, {0xbc789925624c5fe0ull, 0xb67d16413d132072ull},
+    {0xeb96bf6ebadf77d8ull, 0xe41c5bd18c57e88full}, {0x933e37a534cbaae7ull, 0x8e91b962f7b6f159ull},
+    {0xb80dc58e81fe95a1ull, 0x723627bbb5a4adb0ull}, {0xe61136f2227e3b09ull, 0xcec3b1aaa30dd91cull},
+    {0x8fcac257558ee4e6ull, 0x213a4f0aa5e8a7b1ull}, {0xb3bd72ed2af29e1full, 0xa988e2cd4f62d19dull},
+    {0xe0accfa875af45a7ull, 0x93eb1b80a33b8605ull}, {0x8c6c01c9498d8b88ull, 0xbc72f130660533c3ull},
+    {0xaf87023b9bf0ee6aull, 0xeb8fad7c7f8680b4ull}, {0xdb68c2ca82ed2a05ull, 0xa67398db9f6820e1ull},
+    {0x892179be91d43a43ull, 0x88083f8943a1148cull}, {0xab69d82e364948d4ull, 0x6a0a4f6b948959b0ull},
+    {0xd6444e39c3db9b09ull, 0x848ce34679abb01cull}, {0x85eab0e41a6940e5ull, 0xf2d80e0c0c0b4e11ull},
+    {0xa7655d1d2103911full, 0x6f8e118f0f0e2195ull}, {0xd13eb46469447567ull, 0x4b7195f2d2d1a9fbull}
+};
+
+// Eisel-Lemire (Daniel Lemire, "Number Parsing at a Gigabyte per Second"): converts mantissa * 10^exponent
+// with one or two 64x128 bit products, returns false in the rare cases it cannot round with certainty
+static bool cson__eisel_lemire(uint64_t mantissa, int64_t exponent, bool negative, double *result)
+{
+    if (mantissa == 0 || exponent < CSON__POW10_128_MIN || exponent > CSON__POW10_128_MAX) return false;
+    const uint64_t *power = cson__pow10_128[exponent - CSON__POW10_128_MIN];
+    int shift = cson__clz64(mantissa);
+    mantissa <<= shift;
+    // floor(log2(10^exponent)) + 64 + bias
+    uint64_t binary_exponent = (uint64_t) (((217706*exponent) >> 16) + 64 + 1023 - shift);
+    uint64_t lo = mantissa, hi = power[0];
+    cson__mum(&lo, &hi);
+    if ((hi & 0x1FF) == 0x1FF && lo + mantissa < mantissa){
+        // the truncated power might have hidden a carry, include its lower half
+        uint64_t lo2 = mantissa, hi2 = power[1];
+        cson__mum(&lo2, &hi2);
+        uint64_t merged_lo = lo + hi2, merged_hi = hi + (merged_lo < lo);
+        if ((merged_hi & 0x1FF) == 0x1FF && merged_lo + 1 == 0 && lo2 + mantissa < mantissa) return false;
+        hi = merged_hi;
+        lo = merged_lo;
+    }
+    uint64_t msb = hi >> 63;
+    uint64_t bits = hi >> (msb + 9);
+    binary_exponent -= 1 ^ msb;
+    // exactly halfway between two doubles
+    if (lo == 0 && (hi & 0x1FF) == 0 && (bits & 3) == 1) return false;
+    bits = (bits + (bits & 1)) >> 1;
+    if (bits >> 53){
+        bits >>= 1;
+        binary_exponent++;
+    }
+    // subnormals, infinities and zero are left to strtod
+    if (binary_exponent - 1 >= 0x7FF - 1) return false;
+    bits = (binary_exponent << 52) | (bits & 0x000FFFFFFFFFFFFFull) | ((uint64_t) negative << 63);
+    memcpy(result, &bits, sizeof(*result));
+    return true;
+}
+
+// validates and converts a number in one scan, integers that do not fit into int64_t become floats.
+// the scan stops at the first byte that cannot continue the number, *end is set there
+static CsonTokenType cson__lex_scan_number(char *s, char *e, CsonNumber *number, char **end)
+{
+    char *p = s;
+    *end = s;
+    bool negative = false;
+    if (p < e && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    // up to 19 significant digits are collected in mantissa, the value is mantissa * 10^exponent
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int64_t exponent = 0;
+    bool truncated = false;
+    char *digits_start = p;
+    while (p < e && (uint8_t) (*p - '0') < 10){
+        uint8_t digit = *p++ - '0';
+        if (digits < 19){
+            mantissa = mantissa*10 + digit;
+            digits += mantissa != 0;
+        }
+        else{
+            exponent++;
+            truncated |= digit != 0;
+        }
+    }
+    size_t digit_count = p - digits_start;
+    bool is_float = false;
+    if (p < e && *p == '.'){
+        is_float = true;
+        char *fraction_start = ++p;
+        while (p < e && (uint8_t) (*p - '0') < 10){
+            uint8_t digit = *p++ - '0';
+            if (digits < 19){
+                mantissa = mantissa*10 + digit;
+                digits += mantissa != 0;
+                exponent--;
+            }
+            else{
+                truncated |= digit != 0;
+            }
+        }
+        digit_count += p - fraction_start;
+    }
+    if (digit_count == 0) return CsonToken_Invalid;
+    if (p < e && (*p == 'e' || *p == 'E')){
+        is_float = true;
+        p++;
+        bool exp_negative = false;
+        if (p < e && (*p == '-' || *p == '+')) exp_negative = *p++ == '-';
+        if (p == e || (uint8_t) (*p - '0') >= 10) return CsonToken_Invalid;
+        int64_t exp_value = 0;
+        while (p < e && (uint8_t) (*p - '0') < 10){
+            if (exp_value < 100000) exp_value = exp_value*10 + (*p - '0');
+            p++;
+        }
+        exponent += exp_negative? -exp_value:exp_value;
+    }
+    *end = p;
+    if (!is_float && !truncated && exponent == 0 && mantissa <= (uint64_t) INT64_MAX + negative){
+        number->integer = negative? (int64_t) (0 - mantissa):(int64_t) mantissa;
+        return CsonToken_Int;
+    }
+    // Clinger's fast path: mantissas up to 2^53 and powers up to 10^22 are exact doubles, so a single rounding is correct
+    if (!truncated && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22){
+        double value = (double) mantissa;
+        value = (exponent < 0)? value / cson__pow10[-exponent]:value * cson__pow10[exponent];
+        number->floating = negative? -value:value;
+        return CsonToken_Float;
+    }
+    if (mantissa == 0 && !truncated){
+        number->floating = negative? -0.0:0.0;
+        return CsonToken_Float;
+    }
+    if (!truncated){
+        if (cson__eisel_lemire(mantissa, exponent, negative, &number->floating)) return CsonToken_Float;
+    }
+    else{
+        // the dropped digits lie between mantissa and mantissa+1, both have to round to the same double
+        double lower, upper;
+        if (cson__eisel_lemire(mantissa, exponent, negative, &lower) && cson__eisel_lemire(mantissa+1, exponent, negative, &upper) && lower == upper){
+            number->floating = lower;
+            return CsonToken_Float;
+        }
+    }
+    // rare case (subnormals, overflow, exponents beyond 10^±348 or undecidable rounding), let strtod round correctly
+    char buffer[64];
+    size_t len = p - s;
+    char *temp = (len < sizeof(buffer))? buffer:malloc(len+1);
+    cson_assert_alloc(temp);
+    memcpy(temp, s, len);
+    temp[len] = '\0';
+    number->floating = strtod(temp, NULL);
+    if (temp != buffer) free(temp);
+    return CsonToken_Float;
+}
+
+CsonTokenType cson__lex_number(char *s, char *e, CsonNumber *number)
+{
+    char *end;
+    CsonTokenType type = cson__lex_scan_number(s, e, number, &end);
+    return (end == e)? type:CsonToken_Invalid;
+}
+
+// lexes the literal at s up to where its text stops matching, *end is set there
+static CsonTokenType cson__lex_scan_literal(char *s, char *e, CsonNumber *number, char **end)
+{
+    size_t len = e-s;
+    *end = s;
+    switch (*s){
+        case 't':{
+            if (len >= 4 && memcmp(s, "true", 4) == 0) *end = s+4;
+            return (*end != s)? CsonToken_True:CsonToken_Invalid;
+        }
+        case 'f':{
+            if (len >= 5 && memcmp(s, "false", 5) == 0) *end = s+5;
+            return (*end != s)? CsonToken_False:CsonToken_Invalid;
+        }
+        case 'n':{
+            if (len >= 4 && memcmp(s, "null", 4) == 0) *end = s+4;
+            return (*end != s)? CsonToken_Null:CsonToken_Invalid;
+        }
+        default: return cson__lex_scan_number(s, e, number, end);
+    }
+}
+
+bool cson__lex_expect(CsonLexer *lexer, CsonToken *token, CsonTokenType types[], size_t count, char *file, size_t line)
+{
+    if (lexer == NULL || token == NULL) return false;
+    cson_lex_next(lexer, token);
+    for (size_t i=0; i<count; ++i){
+        if (token->type == types[i]) return true;
+    }
+    cson__error_unexpected(cson_token_loc(token), types, count, token->type, file, line);
+    return false;  
+}
+
+bool cson_lex_extract(CsonToken *token, char *buffer, size_t buffer_size)
+{
+    if (token == NULL || buffer == NULL || buffer_size == 0) return false;
+    if (token->len >= buffer_size) return false;
+    size_t len = token->len;
+    if (token->type == CsonToken_String){
+        len = cson_lex_unescape(buffer, token->t_start, token->len);
+    }
+    else{
+        memcpy(buffer, token->t_start, len);
+    }
+    buffer[len] = '\0';
+    return true;
+}
+
+static size_t cson__utf8_encode(char *dst, uint32_t cp)
+{
+    if (cp < 0x80){
+        dst[0] = (char) cp;
+        return 1;
+    }
+    if (cp < 0x800){
+        dst[0] = (char) (0xc0 | (cp >> 6));
+        dst[1] = (char) (0x80 | (cp & 0x3f));
+        return 2;
+    }
+    if (cp < 0x10000){
+        dst[0] = (char) (0xe0 | (cp >> 12));
+        dst[1] = (char) (0x80 | ((cp >> 6) & 0x3f));
+        dst[2] = (char) (0x80 | (cp & 0x3f));
+        return 3;
+    }
+    dst[0] = (char) (0xf0 | (cp >> 18));
+    dst[1] = (char) (0x80 | ((cp >> 12) & 0x3f));
+    dst[2] = (char) (0x80 | ((cp >> 6) & 0x3f));
+    dst[3] = (char) (0x80 | (cp & 0x3f));
+    return 4;
+}
+
+static bool cson__parse_hex4(const char *s, const char *end, uint32_t *out)
+{
+    if (end-s < 4) return false;
+    uint32_t value = 0;
+    for (size_t i=0; i<4; ++i){
+        char c = s[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        else return false;
+    }
+    *out = value;
+    return true;
+}
+
+// decodes the escape sequences of a string token, dst may be equal to src
+size_t cson_lex_unescape(char *dst, const char *src, size_t len)
+{
+    const char *r = src;
+    const char *end = src + len;
+    char *w = dst;
+    while (r < end){
+        const char *bs = memchr(r, '\\', end-r);
+        size_t run = (bs != NULL)? (size_t) (bs-r):(size_t) (end-r);
+        if (w != r) memmove(w, r, run);
+        w += run;
+        r += run;
+        if (bs == NULL || r+1 >= end){
+            if (r < end) *w++ = *r++;
+            break;
+        }
+        r++;
+        switch (*r){
+            case '\'': *w++ = 0x27; break;
+            case '"':  *w++ = 0x22; break;
+            case '?':  *w++ = 0x3f; break;
+            case '\\': *w++ = 0x5c; break;
+            case '/':  *w++ = 0x2f; break;
+            case 'a':  *w++ = 0x07; break;
+            case 'b':  *w++ = 0x08; break;
+            case 'f':  *w++ = 0x0c; break;
+            case 'n':  *w++ = 0x0a; break;
+            case 'r':  *w++ = 0x0d; break;
+            case 't':  *w++ = 0x09; break;
+            case 'v':  *w++ = 0x0b; break;
+            case 'u':{
+                uint32_t cp, low;
+                if (!cson__parse_hex4(r+1, end, &cp)){
+                    *w++ = '\\';
+                    *w++ = *r;
+                    break;
+                }
+                r += 4;
+                if (cp >= 0xd800 && cp < 0xdc00 && end-r > 6 && r[1] == '\\' && r[2] == 'u' && cson__parse_hex4(r+3, end, &low) && low >= 0xdc00 && low < 0xe000){
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    r += 6;
+                }
+                else if (cp >= 0xd800 && cp < 0xe000){
+                    cp = 0xfffd;
+                }
+                w += cson__utf8_encode(w, cp);
+            }break;
+            default:{
+                *w++ = '\\';
+                *w++ = *r;
+            }
+        }
+        r++;
+    }
+    return w-dst;
+}
+
+void cson_lex_print(CsonToken token)
+{
+    cson_info(CSON_LOC_FMT": %s: '%.*s'\n", cson_loc_expand(cson_token_loc(&token)), CsonTokenTypeNames[token.type], (int) (token.t_end-token.t_start), token.t_start);
+}
+
+void cson_lex_set_token(CsonToken *token, CsonTokenType type, char *t_start, char *t_end, CsonLoc loc)
+{
+    if (token == NULL) return;
+    token->type = type;
+    token->t_start = t_start;
+    token->t_end = t_end,
+    token->len = t_end-t_start,
+    token->loc = loc;
+}
+
+// the indexed lexer only records where a token starts, its row and column are counted here
+CsonLoc cson_token_loc(CsonToken *token)
+{
+    // a string token starts after its opening quote
+    char *at = (token->type == CsonToken_String && token->t_start != NULL)? token->t_start-1:token->t_start;
+    CsonLoc loc = cson__loc_resolve(token->loc, at);
+    loc.origin = NULL;
+    return loc;
+}
+
+bool cson_lex_find(CsonLexer *lexer, char c)
+{
+    char rc;
+    while (lexer->index < lexer->buffer_size){
+        if ((rc = cson_lex_get_char(lexer)) == c) return true;
+        cson_lex_check_line(lexer, rc);
+        lexer->index++;
+    }
+    return false;
+}
+
+bool cson_lex_find_unescaped(CsonLexer *lexer, char c)
+{
+    char rc;
+    bool escaped = false;
+    while (lexer->index < lexer->buffer_size){
+        if ((rc = cson_lex_get_char(lexer)) == c && !escaped) return true;
+        escaped = !escaped && rc == '\\';
+        cson_lex_check_line(lexer, rc);
+        lexer->index++;
+    }
+    return false;
+}
+
+void cson_lex_trim_left(CsonLexer *lexer)
+{
+    char c;
+    while (lexer->index <= lexer->buffer_size && cson_lex_is_whitespace((c = cson_lex_get_char(lexer)))){
+        cson_lex_check_line(lexer, c);
+        lexer->index++;
+    }
+}
+
+bool cson_lex_is_delimeter(char c)
+{
+    switch (c){
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case ',':
+        case ':':
+        case ' ':
+        case '\n':
+        case '\t':
+        case '\r':{
+            return true;
+        }
+        default: return false;
+    }
+}
+
+bool cson_lex_is_int(char *s, char *e)
+{
+    if (!s || !e || e-s < 1) return false;
+    if (*s == '-' || *s == '+') s++;
+    while (s < e){
+        if (!isdigit(*s++)) return false;
+    }
+    return true;
+}
+
+bool cson_lex_is_float(char *s, char *e)
+{
+    CsonNumber number;
+    return cson__lex_number(s, e, &number) != CsonToken_Invalid;
+}
+
+void cson__error_unexpected(CsonLoc loc, CsonTokenType expected[], size_t expected_count, CsonTokenType actual, char *filename, size_t line)
+{
+    if (expected_count == 0 || *cson__errors_muted()) return;
+    fprintf(stderr, "%s%s:%zu [ERROR] (%s): Expected [", cson_ansi_rgb(196, 0, 0), filename, line, CsonErrorStrings[CsonError_UnexpectedToken]);
+    size_t i;
+    for (i=0; i<expected_count-1; ++i){
+        fprintf(stderr, "%s, ", CsonTokenTypeNames[expected[i]]);
+    }
+    fprintf(stderr, "%s], but got [%s] at "CSON_LOC_FMT CSON_ANSI_END"\n", CsonTokenTypeNames[expected[i]], CsonTokenTypeNames[actual], cson_loc_expand(loc));
+}
+
+/* Grammar */
+
+typedef enum{
+    CsonGrammar_Value,
+    CsonGrammar_ValueOrClose,
+    CsonGrammar_Key,
+    CsonGrammar_KeyOrClose,
+    CsonGrammar_MapSep,
+    CsonGrammar_SepOrClose,
+    CsonGrammar_Done
+} CsonGrammarState;
+
+typedef enum{
+    CsonEvent_None,
+    CsonEvent_BeginMap,
+    CsonEvent_EndMap,
+    CsonEvent_BeginArray,
+    CsonEvent_EndArray,
+    CsonEvent_Key,
+    CsonEvent_Value
+} CsonEvent;
+
+// token driven json grammar, the nesting is kept on the heap
+typedef struct{
+    CsonGrammarState state;
+    uint8_t *stack;
+    size_t depth;
+    size_t capacity;
+} CsonGrammar;
+
+static void cson__grammar_free(CsonGrammar *grammar)
+{
+    free(grammar->stack);
+    *grammar = (CsonGrammar) {0};
+}
+
+// consumes one token (not CsonToken_End) and reports what it means for the document
+static CsonError cson__grammar_step(CsonGrammar *grammar, CsonToken *token, CsonEvent *event)
+{
+    *event = CsonEvent_None;
+    switch (grammar->state){
+        case CsonGrammar_Done:{
+            cson_error(CsonError_UnexpectedToken, "json object may not have trailing values after closing of parent %s!", CsonTypeStrings[grammar->stack[0]]);
+            return CsonError_UnexpectedToken;
+        }
+        case CsonGrammar_ValueOrClose:
+        case CsonGrammar_Value:{
+            if (grammar->depth == 0 && token->type != CsonToken_MapOpen && token->type != CsonToken_ArrayOpen){
+                cson_error(CsonError_UnexpectedToken, CSON_LOC_FMT": json object may only start with [%s, %s] and not [%s]", cson_loc_expand(cson_token_loc(token)), CsonTokenTypeNames[CsonToken_ArrayOpen], CsonTokenTypeNames[CsonToken_MapOpen], CsonTokenTypeNames[token->type]);
+                return CsonError_UnexpectedToken;
+            }
+            switch (token->type){
+                case CsonToken_MapOpen:
+                case CsonToken_ArrayOpen:{
+                    bool is_map = token->type == CsonToken_MapOpen;
+                    if (grammar->depth >= CSON_MAX_DEPTH){
+                        cson_error(CsonError_DepthExceeded, CSON_LOC_FMT": json object is nested deeper than %d levels", cson_loc_expand(cson_token_loc(token)), CSON_MAX_DEPTH);
+                        return CsonError_DepthExceeded;
+                    }
+                    if (grammar->depth >= grammar->capacity){
+                        size_t capacity = (grammar->capacity == 0)? 64:grammar->capacity*2;
+                        uint8_t *stack = realloc(grammar->stack, capacity);
+                        cson_assert_alloc(stack);
+                        grammar->stack = stack;
+                        grammar->capacity = capacity;
+                    }
+                    grammar->stack[grammar->depth++] = is_map? Cson_Map:Cson_Array;
+                    grammar->state = is_map? CsonGrammar_KeyOrClose:CsonGrammar_ValueOrClose;
+                    *event = is_map? CsonEvent_BeginMap:CsonEvent_BeginArray;
+                    return CsonError_Success;
+                }
+                case CsonToken_ArrayClose:{
+                    if (grammar->state != CsonGrammar_ValueOrClose){
+                        cson_error_unexpected(cson_token_loc(token), token->type, CSON_VALUE_TOKENS);
+                        return CsonError_UnexpectedToken;
+                    }
+                }break;
+                case CsonToken_Int:
+                case CsonToken_Float:
+                case CsonToken_String:
+                case CsonToken_True:
+                case CsonToken_False:
+                case CsonToken_Null:{
+                    grammar->state = CsonGrammar_SepOrClose;
+                    *event = CsonEvent_Value;
+                    return CsonError_Success;
+                }
+                default:{
+                    if (grammar->state == CsonGrammar_ValueOrClose){
+                        cson_error_unexpected(cson_token_loc(token), token->type, CSON_VALUE_TOKENS, CsonToken_ArrayClose);
+                    }
+                    else{
+                        cson_error_unexpected(cson_token_loc(token), token->type, CSON_VALUE_TOKENS);
+                    }
+                    return CsonError_UnexpectedToken;
+                }
+            }
+        }break;
+        case CsonGrammar_KeyOrClose:
+        case CsonGrammar_Key:{
+            if (token->type == CsonToken_String){
+                grammar->state = CsonGrammar_MapSep;
+                *event = CsonEvent_Key;
+                return CsonError_Success;
+            }
+            if (token->type != CsonToken_MapClose || grammar->state != CsonGrammar_KeyOrClose){
+                if (grammar->state == CsonGrammar_KeyOrClose){
+                    cson_error_unexpected(cson_token_loc(token), token->type, CsonToken_String, CsonToken_MapClose);
+                }
+                else{
+                    cson_error_unexpected(cson_token_loc(token), token->type, CsonToken_String);
+                }
+                return CsonError_UnexpectedToken;
+            }
+        }break;
+        case CsonGrammar_MapSep:{
+            if (token->type != CsonToken_MapSep){
+                cson_error_unexpected(cson_token_loc(token), token->type, CsonToken_MapSep);
+                return CsonError_UnexpectedToken;
+            }
+            grammar->state = CsonGrammar_Value;
+            return CsonError_Success;
+        }
+        case CsonGrammar_SepOrClose:{
+            bool in_map = grammar->stack[grammar->depth-1] == Cson_Map;
+            if (token->type == CsonToken_Sep){
+                grammar->state = in_map? CsonGrammar_Key:CsonGrammar_Value;
+                return CsonError_Success;
+            }
+            if (token->type != (in_map? CsonToken_MapClose:CsonToken_ArrayClose)){
+                cson_error_unexpected(cson_token_loc(token), token->type, CsonToken_Sep, in_map? CsonToken_MapClose:CsonToken_ArrayClose);
+                return CsonError_UnexpectedToken;
+            }
+        }break;
+    }
+    // the token closes the innermost container
+    *event = (grammar->stack[--grammar->depth] == Cson_Map)? CsonEvent_EndMap:CsonEvent_EndArray;
+    grammar->state = (grammar->depth == 0)? CsonGrammar_Done:CsonGrammar_SepOrClose;
+    return CsonError_Success;
+}
+
+static CsonError cson__grammar_end(CsonGrammar *grammar, CsonToken *token)
+{
+    (void) token; // only reported when errors are printed
+    if (grammar->state == CsonGrammar_Done) return CsonError_Success;
+    cson_error(CsonError_EndOfBuffer, CSON_LOC_FMT": unexpected end of buffer", cson_loc_expand(cson_token_loc(token)));
+    return CsonError_EndOfBuffer;
+}
+
+/* Tree builder */
+
+typedef struct{
+    Cson container; // the contents are shared with the node in the tree
+    Cson *node; // where the container is stored, NULL while it waits in values[slot]
+    size_t slot;
+    size_t start; // the values of an array begin at values[start]
+    CsonStr key;
+    uint32_t hash;
+} CsonBuildFrame;
+
+// array values are collected on a stack and moved into place once the array is complete,
+// so every array gets exactly one allocation and the nodes never move after parsing
+typedef struct{
+    CsonBuildFrame *stack;
+    size_t depth;
+    size_t capacity;
+    Cson *values;
+    size_t value_count;
+    size_t value_capacity;
+    Cson *root;
+    CsonArena *arena;
+    CsonArena *owner; // arena that completed containers grow in, NULL for arena
+    bool insitu;
+} CsonBuilder;
+
+static void cson__builder_free(CsonBuilder *builder)
+{
+    free(builder->stack);
+    free(builder->values);
+    builder->stack = NULL;
+    builder->depth = 0;
+    builder->capacity = 0;
+    builder->values = NULL;
+    builder->value_count = 0;
+    builder->value_capacity = 0;
+}
+
+// returns the node holding value, or NULL with *slot set if it went onto the value stack
+static Cson* cson__builder_attach(CsonBuilder *builder, Cson value, size_t *slot)
+{
+    if (builder->depth > 0 && builder->stack[builder->depth-1].container.type == Cson_Array){
+        if (builder->value_count >= builder->value_capacity){
+            size_t capacity = (builder->value_capacity == 0)? 256:builder->value_capacity*2;
+            Cson *values = realloc(builder->values, capacity*sizeof(*values));
+            cson_assert_alloc(values);
+            builder->values = values;
+            builder->value_capacity = capacity;
+        }
+        *slot = builder->value_count;
+        builder->values[builder->value_count++] = value;
+        return NULL;
+    }
+    Cson *node = cson__new(builder->arena);
+    *node = value;
+    if (builder->depth == 0){
+        builder->root = node;
+    }
+    else{
+        CsonBuildFrame *frame = &builder->stack[builder->depth-1];
+        cson__map_insert(&frame->container, frame->key, frame->hash, node);
+    }
+    return node;
+}
+
+// cson has to be zeroed
+static void cson__build_scalar(Cson *cson, CsonArena *arena, CsonToken *token, bool insitu)
+{
+    switch (token->type){
+        case CsonToken_Int:{
+            cson->type = Cson_Int;
+            cson->value.integer = token->number.integer;
+        }break;
+        case CsonToken_Float:{
+            cson->type = Cson_Float;
+            cson->value.floating = token->number.floating;
+        }break;
+        case CsonToken_String:{
+            cson->type = Cson_String;
+            if (token->len < CSON_SMALL_STRING){
+                // unescaping never makes a string longer, so short tokens always fit inline
+                size_t len = cson_lex_unescape(cson->value.small, token->t_start, token->len);
+                cson->value.small[len] = '\0';
+                cson->small = (uint8_t) (len + 1);
+            }
+            else{
+                cson->value.string = cson__parse_string(arena, token, insitu);
+            }
+        }break;
+        case CsonToken_True:
+        case CsonToken_False:{
+            cson->type = Cson_Bool;
+            cson->value.boolean = token->type == CsonToken_True;
+        }break;
+        default:{
+            cson->type = Cson_Null;
+            cson->value.null = NULL;
+        }
+    }
+}
+
+// keys copied into the arena are interned, in-situ keys already cost no memory.
+// a full table that rarely matches means the keys are unique data, those are not looked up anymore
+static CsonStr cson__parse_key(CsonArena *arena, CsonToken *token, bool insitu, uint32_t *hash)
+{
+    CsonInternTable *table = &arena->interned;
+    bool unique = table->capacity >= CSON_INTERN_CAPACITY && table->hits < table->count;
+    if (insitu || unique || token->len > CSON_INTERN_MAX_LEN || memchr(token->t_start, '\\', token->len) != NULL){
+        CsonStr key = cson__parse_string(arena, token, insitu);
+        *hash = cson_str_hash(key);
+        return key;
+    }
+    CsonStr raw = {.value=token->t_start, .len=token->len};
+    *hash = cson_str_hash(raw);
+    return cson__str_intern(arena, raw, *hash);
+}
+
+static void cson__build(CsonBuilder *builder, CsonEvent event, CsonToken *token)
+{
+    switch (event){
+        case CsonEvent_BeginMap:
+        case CsonEvent_BeginArray:{
+            Cson container = {.type=Cson_Array};
+            if (event == CsonEvent_BeginMap){
+                container.type = Cson_Map;
+                container.value.map = cson__map_create(builder->arena, cson__map_item_capacity(CSON_MAP_CAPACITY));
+            }
+            size_t slot = 0;
+            Cson *node = cson__builder_attach(builder, container, &slot);
+            if (builder->depth >= builder->capacity){
+                size_t capacity = (builder->capacity == 0)? 64:builder->capacity*2;
+                CsonBuildFrame *stack = realloc(builder->stack, capacity*sizeof(*stack));
+                cson_assert_alloc(stack);
+                builder->stack = stack;
+                builder->capacity = capacity;
+            }
+            builder->stack[builder->depth++] = (CsonBuildFrame) {.container=container, .node=node, .slot=slot, .start=builder->value_count};
+        }break;
+        case CsonEvent_EndMap:
+        case CsonEvent_EndArray:{
+            CsonBuildFrame *frame = &builder->stack[--builder->depth];
+            if (frame->container.type == Cson_Array){
+                size_t count = builder->value_count - frame->start;
+                CsonArray *array = cson__array_create(builder->arena, count);
+                if (count != 0) memcpy(array->head, builder->values + frame->start, count*sizeof(Cson));
+                array->size = count;
+                builder->value_count = frame->start;
+                // the slot of a nested array lies below start, so it is still valid
+                Cson *node = (frame->node != NULL)? frame->node:&builder->values[frame->slot];
+                node->value.array = array;
+                if (builder->owner != NULL) array->arena = builder->owner;
+            }
+            else if (builder->owner != NULL){
+                frame->container.value.map->arena = builder->owner;
+            }
+        }break;
+        case CsonEvent_Key:{
+            CsonBuildFrame *frame = &builder->stack[builder->depth-1];
+            frame->key = cson__parse_key(builder->arena, token, builder->insitu, &frame->hash);
+        }break;
+        case CsonEvent_Value:{
+            Cson value = {0};
+            cson__build_scalar(&value, builder->arena, token, builder->insitu);
+            size_t slot;
+            cson__builder_attach(builder, value, &slot);
+        }break;
+        default: break;
+    }
+}
+
+/* Parser implementation */
+
+CsonStr cson__parse_string(CsonArena *arena, CsonToken *token, bool insitu)
+{
+    char *value;
+    size_t len;
+    if (insitu){
+        // the closing quote is overwritten by the terminator
+        value = token->t_start;
+        len = (memchr(value, '\\', token->len) != NULL)? cson_lex_unescape(value, value, token->len):token->len;
+    }
+    else{
+        value = cson__alloc(arena, token->len+1);
+        cson_assert_alloc(value);
+        len = cson_lex_unescape(value, token->t_start, token->len);
+    }
+    value[len] = '\0';
+    return (CsonStr) {.value=value, .len=len};
+}
+
+Cson* cson_parse_buffer(char *buffer, size_t buffer_size, char *filename)
+{
+    return cson__parse(cson_current_arena, buffer, buffer_size, filename, false);
+}
+
+Cson* cson_parse_insitu(char *buffer, size_t buffer_size, char *filename)
+{
+    return cson__parse(cson_current_arena, buffer, buffer_size, filename, true);
+}
+
+Cson* cson__parse(CsonArena *arena, char *buffer, size_t buffer_size, char *filename, bool insitu)
+{
+    return cson__parse_loc(arena, buffer, buffer_size, (CsonLoc) {.filename=filename, .row=1, .column=1}, insitu);
+}
+
+// parses a buffer that starts at loc of its file
+Cson* cson__parse_loc(CsonArena *arena, char *buffer, size_t buffer_size, CsonLoc loc, bool insitu)
+{
+    if (arena == NULL || buffer == NULL || buffer_size == 0) return NULL;
+    char *filename = loc.filename;
+    // the buffers of the previous parse in this arena are reused
+    CsonParseCache cache = arena->parse_cache;
+    arena->parse_cache = (CsonParseCache) {0};
+    CsonLexer lexer = cson_lex_init(buffer, buffer_size, filename);
+    lexer.loc = loc;
+    lexer.structurals = cache.structurals;
+    lexer.insitu = insitu;
+    (void) cson_lex_index(&lexer);
+    CsonGrammar grammar = {.stack=cache.grammar_stack, .capacity=cache.grammar_capacity};
+    CsonBuilder builder = {
+        .stack=cache.builder_stack, .capacity=cache.builder_capacity,
+        .values=cache.builder_values, .value_capacity=cache.builder_values_capacity,
+        .arena=arena, .insitu=insitu
+    };
+    CsonToken token;
+    CsonEvent event;
+    Cson *cson = NULL;
+    while (true){
+        token.type = CsonToken_Invalid;
+        if (!cson_lex_next(&lexer, &token)){
+            if (token.type != CsonToken_End) break;
+            if (grammar.state == CsonGrammar_Value && grammar.depth == 0){
+                cson_error(CsonError_EndOfBuffer, "file is empty: \"%s\"", filename);
+            }
+            else if (cson__grammar_end(&grammar, &token) == CsonError_Success){
+                cson = builder.root;
+            }
+            break;
+        }
+        if (cson__grammar_step(&grammar, &token, &event) != CsonError_Success) break;
+        cson__build(&builder, event, &token);
+    }
+    arena->parse_cache = (CsonParseCache) {
+        .structurals=lexer.structurals,
+        .grammar_stack=grammar.stack,
+        .grammar_capacity=grammar.capacity,
+        .builder_stack=builder.stack,
+        .builder_capacity=builder.capacity,
+        .builder_values=builder.values,
+        .builder_values_capacity=builder.value_capacity
+    };
+    return cson;
+}
+
+// loads a file into memory owned by the arena, the content is followed by a '\0'
+char* cson__map_file(CsonArena *arena, char *filename, size_t *size)
+{
+    if (arena == NULL || filename == NULL || size == NULL) return NULL;
+#ifdef CSON__MMAP
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1){
+        cson_error(CsonError_FileNotFound, "Could not open file: \"%s\"", filename);
+        return NULL;
+    }
+    struct stat info;
+    long page_size = sysconf(_SC_PAGESIZE);
+    // the zero filled tail of the last page serves as terminator, so a file
+    // ending exactly on a page boundary has to be read instead
+    if (fstat(fd, &info) == 0 && info.st_size > 0 && page_size > 0 && info.st_size % page_size != 0){
+        // private mapping: in-situ parsing writes terminators, the file is never modified
+        void *data = mmap(NULL, (size_t) info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED){
+            close(fd);
+            (void) madvise(data, (size_t) info.st_size, MADV_SEQUENTIAL);
+            CsonMapping *mapping = cson__alloc(arena, sizeof(*mapping));
+            cson_assert_alloc(mapping);
+            mapping->data = data;
+            mapping->size = (size_t) info.st_size;
+            mapping->next = arena->mappings;
+            arena->mappings = mapping;
+            *size = mapping->size;
+            return data;
+        }
+    }
+    close(fd);
+#endif // CSON__MMAP
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL){
+        cson_error(CsonError_FileNotFound, "Could not open file: \"%s\"", filename);
+        return NULL;
+    }
+    uint64_t file_size = cson_file_size(filename);
+    char *content = cson__alloc(arena, file_size+1);
+    cson_assert_alloc(content);
+    size_t total = 0;
+    while (total < file_size){
+        size_t n = fread(content+total, 1, file_size-total, file);
+        if (n == 0) break;
+        total += n;
+    }
+    fclose(file);
+    content[total] = '\0';
+    *size = total;
+    return content;
+}
+
+Cson* cson_read(char *filename)
+{
+    return cson__read(cson_current_arena, filename);
+}
+
+Cson* cson__read(CsonArena *arena, char *filename)
+{
+    size_t size;
+    // the content stays alive in the arena, parsed strings point into it
+    char *content = cson__map_file(arena, filename, &size);
+    if (content == NULL) return NULL;
+    return cson__parse(arena, content, size, filename, true);
+}
+/* Incremental parser implementation */
+
+typedef enum{
+    CsonFeed_Between,
+    CsonFeed_String,
+    CsonFeed_Literal
+} CsonFeedState;
+
+struct CsonParser{
+    CsonGrammar grammar;
+    CsonBuilder builder;
+    CsonError error;
+    CsonLoc loc;
+    CsonFeedState state;
+    bool escaped;
+    CsonLoc token_loc;
+    char *pending;
+    size_t pending_len;
+    size_t pending_capacity;
+};
+
+CsonParser* cson_parser_new(char *filename)
+{
+    return cson__parser_new(cson_current_arena, filename);
+}
+
+CsonParser* cson__parser_new(CsonArena *arena, char *filename)
+{
+    CsonParser *parser = calloc(1, sizeof(*parser));
+    cson_assert_alloc(parser);
+    parser->loc = (CsonLoc) {.filename=filename, .row=1, .column=1};
+    parser->builder.arena = arena;
+    return parser;
+}
+
+void cson_parser_free(CsonParser *parser)
+{
+    if (parser == NULL) return;
+    cson__grammar_free(&parser->grammar);
+    cson__builder_free(&parser->builder);
+    free(parser->pending);
+    free(parser);
+}
+
+// keeps the bytes of a token that continues in the next chunk
+static void cson__parser_hold(CsonParser *parser, char *data, size_t len)
+{
+    if (parser->pending_len + len + 1 > parser->pending_capacity){
+        size_t capacity = (parser->pending_capacity == 0)? 256:parser->pending_capacity;
+        while (capacity < parser->pending_len + len + 1) capacity *= 2;
+        char *pending = realloc(parser->pending, capacity);
+        cson_assert_alloc(pending);
+        parser->pending = pending;
+        parser->pending_capacity = capacity;
+    }
+    memcpy(parser->pending + parser->pending_len, data, len);
+    parser->pending_len += len;
+    parser->pending[parser->pending_len] = '\0';
+}
+
+static CsonError cson__parser_step(CsonParser *parser, CsonToken *token)
+{
+    CsonEvent event;
+    if ((parser->error = cson__grammar_step(&parser->grammar, token, &event)) != CsonError_Success) return parser->error;
+    cson__build(&parser->builder, event, token);
+    return CsonError_Success;
+}
+
+static CsonError cson__parser_token(CsonParser *parser, CsonTokenType type, char *t_start, char *t_end)
+{
+    CsonToken token;
+    cson_lex_set_token(&token, type, t_start, t_end, parser->token_loc);
+    return cson__parser_step(parser, &token);
+}
+
+static CsonError cson__parser_literal(CsonParser *parser, char *t_start, char *t_end)
+{
+    CsonToken token;
+    cson_lex_set_token(&token, CsonToken_Invalid, t_start, t_end, parser->token_loc);
+    parser->state = CsonFeed_Between;
+    if (cson__lex_literal(&token) == CsonToken_Invalid){
+        cson_error(CsonError_InvalidType, "Invalid literal \"%.*s\" at "CSON_LOC_FMT, (int) (t_end-t_start), t_start, cson_loc_expand(parser->token_loc));
+        return parser->error = CsonError_UnexpectedToken;
+    }
+    return cson__parser_step(parser, &token);
+}
+
+CsonError cson_parser_feed(CsonParser *parser, char *chunk, size_t len)
+{
+    if (parser == NULL || (chunk == NULL && len > 0)) return CsonError_InvalidParam;
+    if (parser->error != CsonError_Success) return parser->error;
+    char *p = chunk;
+    char *end = chunk + len;
+    // a token started in a previous chunk continues in pending
+    char *t_start = (parser->state == CsonFeed_Between)? NULL:p;
+    while (p < end){
+        switch (parser->state){
+            case CsonFeed_Between:{
+                char c = *p;
+                if (cson_lex_is_whitespace(c)){
+                    cson_lex_check_line(parser, c);
+                    p++;
+                    continue;
+                }
+                parser->token_loc = parser->loc;
+                CsonTokenType type;
+                switch (c){
+                    case '{': type = CsonToken_MapOpen; break;
+                    case '}': type = CsonToken_MapClose; break;
+                    case '[': type = CsonToken_ArrayOpen; break;
+                    case ']': type = CsonToken_ArrayClose; break;
+                    case ',': type = CsonToken_Sep; break;
+                    case ':': type = CsonToken_MapSep; break;
+                    case '"':{
+                        parser->state = CsonFeed_String;
+                        parser->escaped = false;
+                        parser->pending_len = 0;
+                        parser->loc.column++;
+                        t_start = ++p;
+                    }continue;
+                    default:{
+                        parser->state = CsonFeed_Literal;
+                        parser->pending_len = 0;
+                        t_start = p;
+                    }continue;
+                }
+                parser->loc.column++;
+                if (cson__parser_token(parser, type, p, p+1) != CsonError_Success) return parser->error;
+                p++;
+            }break;
+            case CsonFeed_String:{
+                char c = *p;
+                if (c == '"' && !parser->escaped){
+                    CsonError error;
+                    if (parser->pending_len > 0){
+                        cson__parser_hold(parser, t_start, p-t_start);
+                        error = cson__parser_token(parser, CsonToken_String, parser->pending, parser->pending + parser->pending_len);
                     }
+                    else{
+                        error = cson__parser_token(parser, CsonToken_String, t_start, p);
+                    }
+                    if (error != CsonError_Success) return error;
+                    parser->state = CsonFeed_Between;
+                    parser->loc.column++;
+                    p++;
+                    continue;
+                }
+                parser->escaped = !parser->escaped && c == '\\';
+                cson_lex_check_line(parser, c);
+                p++;
+            }break;
+            case CsonFeed_Literal:{
+                if (!cson_lex_is_delimeter(*p)){
+                    parser->loc.column++;
+                    p++;
+                    continue;
+                }
+                CsonError error;
+                if (parser->pending_len > 0){
+                    cson__parser_hold(parser, t_start, p-t_start);
+                    error = cson__parser_literal(parser, parser->pending, parser->pending + parser->pending_len);
+                }
+                else{
+                    // literals inside a chunk are always followed by their delimiter
+                    error = cson__parser_literal(parser, t_start, p);
+                }
+                if (error != CsonError_Success) return error;
+            }break;
+        }
+    }
+    if (parser->state != CsonFeed_Between){
+        cson__parser_hold(parser, t_start, p-t_start);
+    }
+    return CsonError_Success;
+}
+
+Cson* cson_parser_finish(CsonParser *parser)
+{
+    if (parser == NULL || parser->error != CsonError_Success) return NULL;
+    if (parser->state == CsonFeed_String){
+        cson_error(CsonError_UnclosedString, "Missing closing delimeter for '\"' at " CSON_LOC_FMT "\n", cson_loc_expand(parser->token_loc));
+        parser->error = CsonError_UnclosedString;
+        return NULL;
+    }
+    if (parser->state == CsonFeed_Literal){
+        if (cson__parser_literal(parser, parser->pending, parser->pending + parser->pending_len) != CsonError_Success) return NULL;
+    }
+    CsonToken token;
+    cson_lex_set_token(&token, CsonToken_End, NULL, NULL, parser->loc);
+    if ((parser->error = cson__grammar_end(&parser->grammar, &token)) != CsonError_Success) return NULL;
+    return parser->builder.root;
+}
+
+/* Documents implementation */
+
+CsonDoc* cson_doc_new(void)
+{
+    CsonDoc *doc = calloc(1, sizeof(*doc));
+    cson_assert_alloc(doc);
+    return doc;
+}
+
+void cson_doc_free(CsonDoc *doc)
+{
+    if (doc == NULL) return;
+    cson__free(&doc->arena);
+    free(doc);
+}
+
+Cson* cson_doc_parse(CsonDoc *doc, char *buffer, size_t buffer_size, char *filename)
+{
+    if (doc == NULL) return NULL;
+    return doc->root = cson__parse(&doc->arena, buffer, buffer_size, filename, false);
+}
+
+Cson* cson_doc_parse_insitu(CsonDoc *doc, char *buffer, size_t buffer_size, char *filename)
+{
+    if (doc == NULL) return NULL;
+    return doc->root = cson__parse(&doc->arena, buffer, buffer_size, filename, true);
+}
+
+Cson* cson_doc_read(CsonDoc *doc, char *filename)
+{
+    if (doc == NULL) return NULL;
+    return doc->root = cson__read(&doc->arena, filename);
+}
+
+CsonParser* cson_doc_parser_new(CsonDoc *doc, char *filename)
+{
+    if (doc == NULL) return NULL;
+    return cson__parser_new(&doc->arena, filename);
+}
+
+/* Binary encoding implementation */
+
+typedef enum{
+    CsonCbor_Unsigned = 0,
+    CsonCbor_Negative = 1,
+    CsonCbor_Bytes = 2,
+    CsonCbor_Text = 3,
+    CsonCbor_Array = 4,
+    CsonCbor_Map = 5,
+    CsonCbor_Tag = 6,
+    CsonCbor_Simple = 7,
+} CsonCborMajor;
+
+// the initial byte and the shortest big endian argument for value
+static void cson__cbor_head(CsonBuf *buf, CsonCborMajor major, uint64_t value)
+{
+    uint8_t *out = (uint8_t*) cson__buf_reserve(buf, 9);
+    size_t size = (value < 24)? 0:(value <= UINT8_MAX)? 1:(value <= UINT16_MAX)? 2:(value <= UINT32_MAX)? 4:8;
+    out[0] = (uint8_t) (major << 5) | ((size == 0)? (uint8_t) value:(size == 1)? 24:(size == 2)? 25:(size == 4)? 26:27);
+    for (size_t i=0; i<size; ++i){
+        out[size-i] = (uint8_t) (value >> (8*i));
+    }
+    buf->size += 1 + size;
+}
+
+static void cson__cbor_float(CsonBuf *buf, double value)
+{
+    uint8_t *out = (uint8_t*) cson__buf_reserve(buf, 9);
+    // single precision whenever it is exact, nan keeps its payload in double precision
+    // finite values beyond FLT_MAX must not be narrowed, the conversion would be undefined
+    bool in_range = value != value || value - value != 0 || (value >= -FLT_MAX && value <= FLT_MAX);
+    float single = in_range? (float) value:0.0f;
+    if (in_range && (double) single == value){
+        uint32_t bits;
+        memcpy(&bits, &single, sizeof(bits));
+        out[0] = (CsonCbor_Simple << 5) | 26;
+        for (size_t i=0; i<4; ++i) out[4-i] = (uint8_t) (bits >> (8*i));
+        buf->size += 5;
+        return;
+    }
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    out[0] = (CsonCbor_Simple << 5) | 27;
+    for (size_t i=0; i<8; ++i) out[8-i] = (uint8_t) (bits >> (8*i));
+    buf->size += 9;
+}
+
+CsonError cson_serialize_binary(Cson *cson, CsonBuf *buf)
+{
+    if (cson == NULL || buf == NULL) return CsonError_InvalidParam;
+    CsonSerializeFrame *stack = NULL;
+    size_t depth = 0, capacity = 0;
+    CsonError result = CsonError_Success;
+    Cson *value = cson;
+    while (value != NULL){
+        switch (value->type){
+            case Cson_Int:{
+                int64_t n = value->value.integer;
+                if (n < 0) cson__cbor_head(buf, CsonCbor_Negative, (uint64_t) -(n + 1));
+                else cson__cbor_head(buf, CsonCbor_Unsigned, (uint64_t) n);
+            }break;
+            case Cson_Float: cson__cbor_float(buf, value->value.floating); break;
+            case Cson_Bool: cson__buf_push(buf, (char) ((CsonCbor_Simple << 5) | (value->value.boolean? 21:20))); break;
+            case Cson_Null: cson__buf_push(buf, (char) ((CsonCbor_Simple << 5) | 22)); break;
+            case Cson_String:{
+                CsonStr str = cson__to_string(value);
+                cson__cbor_head(buf, CsonCbor_Text, str.len);
+                cson__buf_append(buf, str.value, str.len);
+            }break;
+            case Cson_Array:
+            case Cson_Map:{
+                cson__cbor_head(buf, (value->type == Cson_Map)? CsonCbor_Map:CsonCbor_Array, cson_len(value));
+                if (cson_len(value) == 0) break;
+                if (depth >= capacity){
+                    capacity = (capacity == 0)? 64:capacity*2;
+                    CsonSerializeFrame *temp = realloc(stack, capacity*sizeof(*stack));
+                    cson_assert_alloc(temp);
+                    stack = temp;
+                }
+                stack[depth++] = (CsonSerializeFrame) {.container=value, .index=0};
+            }break;
+            default:{
+                cson_error(CsonError_InvalidType, "Invalid value type: %d", value->type);
+                result = CsonError_InvalidType;
+                depth = 0;
+            }
+        }
+        // the next value, there are no closing bytes for finished containers
+        value = NULL;
+        while (depth > 0){
+            CsonSerializeFrame *frame = &stack[depth-1];
+            if (frame->count == cson_len(frame->container)){
+                depth--;
+                continue;
+            }
+            frame->count++;
+            if (frame->container->type == Cson_Map){
+                CsonMapItem *item = cson__map_next(frame->container->value.map, &frame->index);
+                cson__cbor_head(buf, CsonCbor_Text, item->key.len);
+                cson__buf_append(buf, item->key.value, item->key.len);
+                value = item->value;
+            }
+            else{
+                value = cson__array_at(frame->container->value.array, frame->index++);
+            }
+            break;
+        }
+    }
+    free(stack);
+    return result;
+}
+
+bool cson_write_binary(Cson *json, char *filename)
+{
+    if (json == NULL || filename == NULL) return false;
+    CsonBuf buf = {0};
+    if (cson_serialize_binary(json, &buf) != CsonError_Success){
+        cson_buf_free(&buf);
+        return false;
+    }
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL){
+        cson_error(CsonError_FileNotFound, "Could not find file: \"%s\"", filename);
+        cson_buf_free(&buf);
+        return false;
+    }
+    bool result = fwrite(buf.data, 1, buf.size, file) == buf.size;
+    result = (fclose(file) == 0) && result;
+    cson_buf_free(&buf);
+    return result;
+}
+
+// widens a half precision float by moving its fields into single precision
+static double cson__cbor_half(uint16_t half)
+{
+    uint32_t sign = (uint32_t) (half & 0x8000) << 16, exponent = (half >> 10) & 0x1F, mantissa = half & 0x3FF;
+    if (exponent == 0){
+        // subnormals are exact multiples of 2^-24
+        double value = mantissa / 16777216.0;
+        return sign? -value:value;
+    }
+    uint32_t bits = sign | ((exponent == 31)? 0x7F800000:(exponent + 112) << 23) | mantissa << 13;
+    float single;
+    memcpy(&single, &bits, sizeof(single));
+    return single;
+}
+
+typedef struct{
+    Cson *container;
+    size_t remaining; // items left, a map counts its keys and values
+    CsonStr key;
+    uint32_t hash;
+} CsonBinaryFrame;
+
+Cson* cson_parse_binary(char *buffer, size_t buffer_size, char *filename)
+{
+    return cson__parse_binary(cson_current_arena, buffer, buffer_size, filename);
+}
+
+Cson* cson__parse_binary(CsonArena *arena, char *buffer, size_t buffer_size, char *filename)
+{
+    if (arena == NULL || buffer == NULL) return NULL;
+    (void) filename;
+    const uint8_t *data = (const uint8_t*) buffer;
+    size_t pos = 0;
+    CsonBinaryFrame *stack = NULL;
+    size_t depth = 0, capacity = 0;
+    Cson *root = NULL;
+    bool failed = false;
+    while (!failed){
+        size_t start = pos; // for error messages
+        (void) start;
+        if (pos >= buffer_size){
+            cson_error(CsonError_EndOfBuffer, "%s:%zu: unexpected end of binary data", filename, pos);
+            failed = true;
+            break;
+        }
+        uint8_t major = data[pos] >> 5, info = data[pos] & 0x1F;
+        pos++;
+        uint64_t argument = info;
+        if (info >= 24 && info <= 27){
+            size_t size = (size_t) 1 << (info - 24);
+            if (buffer_size - pos < size){
+                cson_error(CsonError_EndOfBuffer, "%s:%zu: unexpected end of binary data", filename, start);
+                failed = true;
+                break;
+            }
+            argument = 0;
+            for (size_t i=0; i<size; ++i) argument = (argument << 8) | data[pos++];
+        }
+        else if (info > 27){
+            // indefinite lengths would defeat sizing the containers up front
+            cson_error(CsonError_Unimplemented, "%s:%zu: unsupported binary item 0x%02x", filename, start, data[start]);
+            failed = true;
+            break;
+        }
+        bool want_key = depth > 0 && stack[depth-1].container->type == Cson_Map && stack[depth-1].remaining % 2 == 0;
+        if (major == CsonCbor_Tag) continue; // tags only annotate the following item
+        if (want_key && major != CsonCbor_Text){
+            cson_error(CsonError_InvalidType, "%s:%zu: map keys have to be strings", filename, start);
+            failed = true;
+            break;
+        }
+        Cson item = {0};
+        switch (major){
+            case CsonCbor_Unsigned:
+            case CsonCbor_Negative:{
+                if (argument > INT64_MAX){
+                    cson_error(CsonError_InvalidType, "%s:%zu: integer does not fit into 64 bits", filename, start);
+                    failed = true;
+                    break;
+                }
+                item = cson_int((major == CsonCbor_Unsigned)? (int64_t) argument:-1 - (int64_t) argument);
+            }break;
+            case CsonCbor_Text:{
+                if (buffer_size - pos < argument){
+                    cson_error(CsonError_EndOfBuffer, "%s:%zu: unexpected end of binary data", filename, start);
+                    failed = true;
+                    break;
+                }
+                CsonStr str = {.value=(char*) data + pos, .len=(size_t) argument};
+                pos += (size_t) argument;
+                if (want_key){
+                    stack[depth-1].hash = cson_str_hash(str);
+                    stack[depth-1].key = (CsonStr) {.value=cson_dup(arena, str.value, str.len, str.len+1), .len=str.len};
+                    stack[depth-1].remaining--;
+                    continue;
+                }
+                cson__set_string(arena, &item, str);
+            }break;
+            case CsonCbor_Array:
+            case CsonCbor_Map:{
+                // every item takes at least one byte, so a corrupt length cannot allocate more than the data
+                uint64_t items = (major == CsonCbor_Map)? argument*2:argument;
+                if (argument > buffer_size - pos || items > buffer_size - pos){
+                    cson_error(CsonError_EndOfBuffer, "%s:%zu: container is longer than the binary data", filename, start);
+                    failed = true;
+                    break;
+                }
+                if (depth >= CSON_MAX_DEPTH){
+                    cson_error(CsonError_DepthExceeded, "%s:%zu: binary data is nested deeper than %d levels", filename, start, CSON_MAX_DEPTH);
+                    failed = true;
+                    break;
+                }
+                item.type = (major == CsonCbor_Map)? Cson_Map:Cson_Array;
+                if (major == CsonCbor_Map) item.value.map = cson__map_create(arena, (size_t) argument);
+                else item.value.array = cson__array_create(arena, (size_t) argument);
+            }break;
+            case CsonCbor_Simple:{
+                if (info == 20 || info == 21) item = cson_bool(info == 21);
+                else if (info == 22 || info == 23) item = cson_null();
+                else if (info == 25) item = cson_float(cson__cbor_half((uint16_t) argument));
+                else if (info == 26){
+                    uint32_t bits = (uint32_t) argument;
+                    float single;
+                    memcpy(&single, &bits, sizeof(single));
+                    item = cson_float(single);
+                }
+                else if (info == 27){
+                    double floating;
+                    memcpy(&floating, &argument, sizeof(floating));
+                    item = cson_float(floating);
+                }
+                else{
+                    cson_error(CsonError_Unimplemented, "%s:%zu: unsupported binary item 0x%02x", filename, start, data[start]);
+                    failed = true;
+                }
+            }break;
+            default:{
+                // byte strings have no json counterpart
+                cson_error(CsonError_Unimplemented, "%s:%zu: unsupported binary item 0x%02x", filename, start, data[start]);
+                failed = true;
+            }
+        }
+        if (failed) break;
+        // arrays are sized up front, so array values are written in place and never move
+        Cson *value;
+        if (depth == 0){
+            value = root = cson__new(arena);
+        }
+        else{
+            CsonBinaryFrame *frame = &stack[depth-1];
+            if (frame->container->type == Cson_Map){
+                value = cson__new(arena);
+                cson__map_insert(frame->container, frame->key, frame->hash, value);
+            }
+            else{
+                CsonArray *array = frame->container->value.array;
+                value = &array->head[array->size++];
+            }
+            frame->remaining--;
+        }
+        *value = item;
+        if ((value->type == Cson_Array || value->type == Cson_Map) && argument > 0){
+            if (depth >= capacity){
+                capacity = (capacity == 0)? 64:capacity*2;
+                CsonBinaryFrame *temp = realloc(stack, capacity*sizeof(*stack));
+                cson_assert_alloc(temp);
+                stack = temp;
+            }
+            stack[depth++] = (CsonBinaryFrame) {.container=value, .remaining=(value->type == Cson_Map)? (size_t) argument*2:(size_t) argument};
+        }
+        while (depth > 0 && stack[depth-1].remaining == 0) depth--;
+        if (depth == 0) break;
+    }
+    free(stack);
+    if (failed) return NULL;
+    if (pos != buffer_size){
+        cson_error(CsonError_UnexpectedToken, "%s:%zu: unexpected data after the root value", filename, pos);
+        return NULL;
+    }
+    return root;
+}
+
+Cson* cson_read_binary(char *filename)
+{
+    return cson__read_binary(cson_current_arena, filename);
+}
+
+Cson* cson__read_binary(CsonArena *arena, char *filename)
+{
+    size_t size;
+    char *content = cson__map_file(arena, filename, &size);
+    if (content == NULL) return NULL;
+    return cson__parse_binary(arena, content, size, filename);
+}
+
+/* Snapshot implementation */
+
+// strings are followed by a '\0'. containers are 16 byte aligned: arrays hold their values,
+// maps a table of (hash, item) sorted by hash followed by the items as key and value pairs
+#define CSON__SNAP_MAGIC "CSONSNAP"
+#define CSON__SNAP_VERSION 1
+#define CSON__SNAP_BYTE_ORDER 0x01020304
+#define cson__snap_align(size) (((size) + 15) & ~(size_t) 15)
+
+typedef struct{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order; // tells apart snapshots written on a machine of different endianness
+    uint64_t size;
+    uint64_t reserved;
+    CsonSnapValue root;
+} CsonSnapHeader;
+
+typedef struct{
+    uint32_t hash;
+    uint32_t item;
+} CsonSnapIndex;
+
+typedef struct{
+    size_t slot;
+    Cson *container;
+} CsonSnapWork;
+
+_Static_assert(sizeof(CsonSnapValue) == 16, "CsonSnapValue has to be 16 bytes!");
+_Static_assert(sizeof(CsonSnapHeader) % 16 == 0, "CsonSnapHeader has to keep the alignment!");
+
+static int cson__snap_index_compare(const void *a, const void *b)
+{
+    uint32_t x = ((const CsonSnapIndex*) a)->hash, y = ((const CsonSnapIndex*) b)->hash;
+    return (x > y) - (x < y);
+}
+
+// appends size zeroed bytes at a 16 byte boundary, returns their position
+static size_t cson__snap_reserve(CsonBuf *buf, size_t size)
+{
+    size_t pos = cson__snap_align(buf->size);
+    size_t total = pos + size - buf->size;
+    memset(cson__buf_reserve(buf, total), 0, total);
+    buf->size += total;
+    return pos;
+}
+
+static bool cson__snap_string(CsonBuf *buf, size_t slot, CsonStr str)
+{
+    if (str.len > UINT32_MAX){
+        cson_error(CsonError_InvalidParam, "string of %zu bytes is too long for a snapshot", str.len);
+        return false;
+    }
+    CsonSnapValue value = {.type=Cson_String, .len=(uint32_t) str.len, .as.offset=buf->size - slot};
+    cson__buf_append(buf, str.value, str.len);
+    cson__buf_push(buf, '\0');
+    memcpy(buf->data + slot, &value, sizeof(value));
+    return true;
+}
+
+// fills the slot of a value, containers are queued and laid out later
+static bool cson__snap_value(CsonBuf *buf, size_t slot, Cson *cson, CsonSnapWork **work, size_t *count, size_t *capacity)
+{
+    CsonSnapValue value = {.type=cson->type};
+    switch (cson->type){
+        case Cson_Int: value.as.integer = cson->value.integer; break;
+        case Cson_Float: value.as.floating = cson->value.floating; break;
+        case Cson_Bool: value.as.boolean = cson->value.boolean; break;
+        case Cson_Null: break;
+        case Cson_String: return cson__snap_string(buf, slot, cson__to_string(cson));
+        case Cson_Array:
+        case Cson_Map:{
+            if (cson_len(cson) > UINT32_MAX){
+                cson_error(CsonError_InvalidParam, "container of %zu members is too large for a snapshot", cson_len(cson));
+                return false;
+            }
+            value.len = (uint32_t) cson_len(cson);
+            if (*count >= *capacity){
+                *capacity = (*capacity == 0)? 64:*capacity*2;
+                CsonSnapWork *temp = realloc(*work, *capacity*sizeof(**work));
+                cson_assert_alloc(temp);
+                *work = temp;
+            }
+            (*work)[(*count)++] = (CsonSnapWork) {.slot=slot, .container=cson};
+        }break;
+        default:{
+            cson_error(CsonError_InvalidType, "Invalid value type: %d", cson->type);
+            return false;
+        }
+    }
+    memcpy(buf->data + slot, &value, sizeof(value));
+    return true;
+}
+
+// containers are laid out breadth first, so the members of a container are next to each other
+CsonError cson_snap_serialize(Cson *cson, CsonBuf *buf)
+{
+    if (cson == NULL || buf == NULL || buf->size != 0) return CsonError_InvalidParam;
+    CsonSnapWork *work = NULL;
+    size_t count = 0, capacity = 0;
+    bool success = true;
+    (void) cson__snap_reserve(buf, sizeof(CsonSnapHeader));
+    success = cson__snap_value(buf, offsetof(CsonSnapHeader, root), cson, &work, &count, &capacity);
+    for (size_t i=0; i<count && success; ++i){
+        CsonSnapWork item = work[i];
+        size_t len = cson_len(item.container);
+        if (len == 0) continue;
+        size_t data;
+        if (item.container->type == Cson_Array){
+            data = cson__snap_reserve(buf, len*sizeof(CsonSnapValue));
+            CsonArray *array = item.container->value.array;
+            for (size_t j=0; j<len && success; ++j){
+                success = cson__snap_value(buf, data + j*sizeof(CsonSnapValue), cson__array_at(array, j), &work, &count, &capacity);
+            }
+        }
+        else{
+            size_t table = cson__snap_align(len*sizeof(CsonSnapIndex));
+            data = cson__snap_reserve(buf, table + 2*len*sizeof(CsonSnapValue));
+            CsonMap *map = item.container->value.map;
+            CsonSnapIndex *index = (CsonSnapIndex*) (buf->data + data);
+            size_t position = 0;
+            for (size_t j=0; j<len; ++j){
+                index[j] = (CsonSnapIndex) {.hash=cson__map_next(map, &position)->hash, .item=(uint32_t) j};
+            }
+            qsort(index, len, sizeof(*index), cson__snap_index_compare);
+            size_t items = data + table;
+            position = 0;
+            for (size_t j=0; j<len && success; ++j){
+                CsonMapItem *member = cson__map_next(map, &position);
+                success = cson__snap_string(buf, items + 2*j*sizeof(CsonSnapValue), member->key)
+                    && cson__snap_value(buf, items + (2*j+1)*sizeof(CsonSnapValue), member->value, &work, &count, &capacity);
+            }
+        }
+        uint64_t offset = data - item.slot;
+        memcpy(buf->data + item.slot + offsetof(CsonSnapValue, as), &offset, sizeof(offset));
+    }
+    free(work);
+    if (!success) return CsonError_InvalidParam;
+    CsonSnapHeader header;
+    memcpy(&header, buf->data, sizeof(header));
+    memcpy(header.magic, CSON__SNAP_MAGIC, sizeof(header.magic));
+    header.version = CSON__SNAP_VERSION;
+    header.byte_order = CSON__SNAP_BYTE_ORDER;
+    header.size = buf->size;
+    memcpy(buf->data, &header, sizeof(header));
+    return CsonError_Success;
+}
+
+bool cson_snap_write(Cson *cson, char *filename)
+{
+    if (cson == NULL || filename == NULL) return false;
+    CsonBuf buf = {0};
+    if (cson_snap_serialize(cson, &buf) != CsonError_Success){
+        cson_buf_free(&buf);
+        return false;
+    }
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL){
+        cson_error(CsonError_FileNotFound, "Could not find file: \"%s\"", filename);
+        cson_buf_free(&buf);
+        return false;
+    }
+    bool result = fwrite(buf.data, 1, buf.size, file) == buf.size;
+    result = (fclose(file) == 0) && result;
+    cson_buf_free(&buf);
+    return result;
+}
+
+bool cson_snap_init(CsonSnap *snap, char *buffer, size_t buffer_size)
+{
+    if (snap == NULL || buffer == NULL) return false;
+    *snap = (CsonSnap) {0};
+    if ((uintptr_t) buffer % 8 != 0){
+        cson_error(CsonError_InvalidParam, "snapshot buffer is not 8 byte aligned");
+        return false;
+    }
+    CsonSnapHeader header;
+    if (buffer_size < sizeof(header)){
+        cson_error(CsonError_EndOfBuffer, "buffer is too small for a snapshot");
+        return false;
+    }
+    memcpy(&header, buffer, sizeof(header));
+    if (memcmp(header.magic, CSON__SNAP_MAGIC, sizeof(header.magic)) != 0 || header.version != CSON__SNAP_VERSION || header.byte_order != CSON__SNAP_BYTE_ORDER){
+        cson_error(CsonError_InvalidType, "buffer is not a compatible snapshot");
+        return false;
+    }
+    if (header.size != buffer_size || header.root.type >= Cson__TypeCount){
+        cson_error(CsonError_EndOfBuffer, "snapshot is truncated or corrupt");
+        return false;
+    }
+    snap->data = buffer;
+    snap->size = buffer_size;
+    return true;
+}
+
+bool cson_snap_open(CsonSnap *snap, char *filename)
+{
+    if (snap == NULL || filename == NULL) return false;
+#ifdef CSON__MMAP
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1){
+        cson_error(CsonError_FileNotFound, "Could not open file: \"%s\"", filename);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0){
+        // shared and read-only: every process using the snapshot maps the same pages of the page cache
+        void *data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED){
+            close(fd);
+            if (!cson_snap_init(snap, data, (size_t) info.st_size)){
+                munmap(data, (size_t) info.st_size);
+                return false;
+            }
+            snap->mapped = true;
+            return true;
+        }
+    }
+    close(fd);
+#endif // CSON__MMAP
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL){
+        cson_error(CsonError_FileNotFound, "Could not open file: \"%s\"", filename);
+        return false;
+    }
+    uint64_t file_size = cson_file_size(filename);
+    // malloc keeps the alignment the values need
+    char *content = malloc(file_size > 0? file_size:1);
+    cson_assert_alloc(content);
+    size_t total = 0;
+    while (total < file_size){
+        size_t n = fread(content+total, 1, file_size-total, file);
+        if (n == 0) break;
+        total += n;
+    }
+    fclose(file);
+    if (!cson_snap_init(snap, content, total)){
+        free(content);
+        return false;
+    }
+    snap->owned = true;
+    return true;
+}
+
+void cson_snap_close(CsonSnap *snap)
+{
+    if (snap == NULL) return;
+#ifdef CSON__MMAP
+    if (snap->mapped) munmap(snap->data, snap->size);
+#endif // CSON__MMAP
+    if (snap->owned) free(snap->data);
+    *snap = (CsonSnap) {0};
+}
+
+const CsonSnapValue* cson_snap_root(CsonSnap *snap)
+{
+    if (snap == NULL || snap->data == NULL) return NULL;
+    return (const CsonSnapValue*) (snap->data + offsetof(CsonSnapHeader, root));
+}
+
+#define cson__snap_data(value) ((const char*) (value) + (value)->as.offset)
+// the type comes from the file, so it is checked before naming it
+#define cson__snap_type_name(value) (((value)->type < Cson__TypeCount)? CsonTypeStrings[(value)->type]:"an invalid type")
+
+size_t cson_snap_len(const CsonSnapValue *value)
+{
+    if (value == NULL) return 0;
+    switch (value->type){
+        case Cson_String:
+        case Cson_Array:
+        case Cson_Map: return value->len;
+        default:{
+            cson_error(CsonError_InvalidType, "value of type %s does not have a length.", cson__snap_type_name(value));
+            return 0;
+        }
+    }
+}
+
+const CsonSnapValue* cson_snap_array_get(const CsonSnapValue *array, size_t index)
+{
+    if (array == NULL || array->type != Cson_Array || index >= array->len) return NULL;
+    return (const CsonSnapValue*) cson__snap_data(array) + index;
+}
+
+const CsonSnapValue* cson_snap_map_item(const CsonSnapValue *map, size_t index, CsonStr *key)
+{
+    if (map == NULL || map->type != Cson_Map || index >= map->len) return NULL;
+    const CsonSnapValue *item = (const CsonSnapValue*) (cson__snap_data(map) + cson__snap_align(map->len*sizeof(CsonSnapIndex))) + 2*index;
+    if (key != NULL) *key = (CsonStr) {.value=(char*) cson__snap_data(item), .len=item->len};
+    return item + 1;
+}
+
+const CsonSnapValue* cson_snap_map_get(const CsonSnapValue *map, CsonStr key)
+{
+    if (map == NULL || map->type != Cson_Map || key.value == NULL) return NULL;
+    const CsonSnapIndex *index = (const CsonSnapIndex*) cson__snap_data(map);
+    uint32_t hash = cson_str_hash(key);
+    // first entry with the hash, colliding keys follow it
+    size_t low = 0, high = map->len;
+    while (low < high){
+        size_t mid = low + (high - low)/2;
+        if (index[mid].hash < hash) low = mid + 1;
+        else high = mid;
+    }
+    for (; low < map->len && index[low].hash == hash; ++low){
+        CsonStr name = {0};
+        const CsonSnapValue *value = cson_snap_map_item(map, index[low].item, &name);
+        if (value == NULL) continue;
+        if (cson_str_equals(name, key)) return value;
+    }
+    return NULL;
+}
+
+const CsonSnapValue* cson__snap_get(const CsonSnapValue *value, CsonArg args[], size_t count)
+{
+    for (size_t i=0; i<count && value != NULL; ++i){
+        CsonArg arg = args[i];
+        if (arg.type == CsonArg_Key && value->type == Cson_Map){
+            value = cson_snap_map_get(value, arg.value.key);
+        }
+        else if (arg.type == CsonArg_Index && value->type == Cson_Array){
+            value = cson_snap_array_get(value, arg.value.index);
+        }
+        else{
+            cson_error(CsonError_InvalidType, "Cannot access %s via %s!", cson__snap_type_name(value), CsonArgStrings[arg.type]);
+            return NULL;
+        }
+    }
+    return value;
+}
+
+bool cson__snap_get_int(int64_t *out, const CsonSnapValue *value)
+{
+    if (out == NULL || value == NULL || value->type != Cson_Int) return false;
+    *out = value->as.integer;
+    return true;
+}
+
+bool cson__snap_get_float(double *out, const CsonSnapValue *value)
+{
+    if (out == NULL || value == NULL || value->type != Cson_Float) return false;
+    *out = value->as.floating;
+    return true;
+}
+
+bool cson__snap_get_bool(bool *out, const CsonSnapValue *value)
+{
+    if (out == NULL || value == NULL || value->type != Cson_Bool) return false;
+    *out = value->as.boolean != 0;
+    return true;
+}
+
+bool cson__snap_get_string(CsonStr *out, const CsonSnapValue *value)
+{
+    if (out == NULL || value == NULL || value->type != Cson_String) return false;
+    *out = (CsonStr) {.value=(char*) cson__snap_data(value), .len=value->len};
+    return true;
+}
+
+bool cson__snap_get_cstring(char **out, const CsonSnapValue *value)
+{
+    if (out == NULL || value == NULL || value->type != Cson_String) return false;
+    *out = (char*) cson__snap_data(value);
+    return true;
+}
+
+/* Query implementation */
+
+typedef struct{
+    const char *expression;
+    const char *p;
+    CsonQuery *query;
+    char *strings; // next free byte of query->strings
+} CsonQueryCompiler;
+
+static bool cson__query_or(CsonQueryCompiler *c, size_t *out);
+
+// grows an array of the query when its count reaches a power of two
+static void* cson__query_grow(void *items, size_t count, size_t size)
+{
+    if (count != 0 && (count < 4 || (count & (count-1)) != 0)) return items;
+    void *grown = realloc(items, ((count < 4)? 4:count*2)*size);
+    cson_assert_alloc(grown);
+    return grown;
+}
+
+static void cson__query_skip(CsonQueryCompiler *c)
+{
+    while (*c->p == ' ' || *c->p == '\t' || *c->p == '\n' || *c->p == '\r') c->p++;
+}
+
+static bool cson__query_fail(CsonQueryCompiler *c, const char *reason)
+{
+    cson_error(CsonError_InvalidParam, "%s at offset %zu of query \"%s\"", reason, (size_t) (c->p - c->expression), c->expression);
+    (void) c;
+    (void) reason;
+    return false;
+}
+
+static bool cson__query_name_char(char c, bool first)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (uint8_t) c >= 0x80 || (!first && c >= '0' && c <= '9');
+}
+
+// reads a dot notation name or a quoted string, every name is shorter than its source so the string buffer cannot overflow
+static bool cson__query_string(CsonQueryCompiler *c, CsonStr *out)
+{
+    char *start = c->strings;
+    size_t len;
+    if (*c->p == '\'' || *c->p == '"'){
+        char quote = *c->p++;
+        const char *begin = c->p;
+        while (*c->p != quote){
+            if (*c->p == '\0') return cson__query_fail(c, "Unclosed string");
+            if (*c->p == '\\' && c->p[1] != '\0') c->p++;
+            c->p++;
+        }
+        len = cson_lex_unescape(start, begin, c->p - begin);
+        c->p++;
+    }
+    else{
+        const char *begin = c->p;
+        while (cson__query_name_char(*c->p, c->p == begin)) c->p++;
+        if (c->p == begin) return cson__query_fail(c, "Expected a name");
+        len = c->p - begin;
+        memcpy(start, begin, len);
+    }
+    start[len] = '\0';
+    c->strings += len + 1;
+    *out = (CsonStr) {.value=start, .len=len};
+    return true;
+}
+
+static bool cson__query_int(CsonQueryCompiler *c, int64_t *out)
+{
+    const char *digits = (*c->p == '-')? c->p+1:c->p;
+    if (*digits < '0' || *digits > '9') return false;
+    char *end;
+    *out = strtoll(c->p, &end, 10);
+    c->p = end;
+    return true;
+}
+
+static size_t cson__query_expr(CsonQueryCompiler *c, CsonExpr expr)
+{
+    CsonQuery *query = c->query;
+    query->exprs = cson__query_grow(query->exprs, query->expr_count, sizeof(*query->exprs));
+    query->exprs[query->expr_count] = expr;
+    return query->expr_count++;
+}
+
+static bool cson__query_keyword(CsonQueryCompiler *c, const char *keyword)
+{
+    size_t len = strlen(keyword);
+    if (strncmp(c->p, keyword, len) != 0 || cson__query_name_char(c->p[len], false)) return false;
+    c->p += len;
+    return true;
+}
+
+static bool cson__query_operand(CsonQueryCompiler *c, CsonOperand *operand)
+{
+    *operand = (CsonOperand) {0};
+    if (*c->p == '@' || *c->p == '$'){
+        // the path of a filter is compiled into a CsonPath
+        operand->absolute = (*c->p++ == '$');
+        CsonArg *args = NULL;
+        size_t count = 0;
+        while (*c->p == '.' || *c->p == '['){
+            CsonArg arg = {.type=CsonArg_Key};
+            if (*c->p++ == '.'){
+                if (!cson__query_string(c, &arg.value.key)) goto fail;
+            }
+            else{
+                cson__query_skip(c);
+                int64_t index;
+                if (*c->p == '\'' || *c->p == '"'){
+                    if (!cson__query_string(c, &arg.value.key)) goto fail;
+                }
+                else if (cson__query_int(c, &index) && index >= 0){
+                    arg = (CsonArg) {.value.index=(size_t) index, .type=CsonArg_Index};
+                }
+                else{
+                    cson__query_fail(c, "Expected a key or an index");
+                    goto fail;
+                }
+                cson__query_skip(c);
+                if (*c->p++ != ']'){
+                    c->p--;
+                    cson__query_fail(c, "Expected ']'");
+                    goto fail;
+                }
+            }
+            args = cson__query_grow(args, count, sizeof(*args));
+            args[count++] = arg;
+        }
+        operand->path = cson__path_new(args, count);
+        free(args);
+        return true;
+    fail:
+        free(args);
+        return false;
+    }
+    if (*c->p == '\'' || *c->p == '"'){
+        operand->literal.type = Cson_String;
+        return cson__query_string(c, &operand->literal.value.string);
+    }
+    if (cson__query_keyword(c, "true")){
+        operand->literal = (Cson) {.value.boolean=true, .type=Cson_Bool};
+        return true;
+    }
+    if (cson__query_keyword(c, "false")){
+        operand->literal = (Cson) {.value.boolean=false, .type=Cson_Bool};
+        return true;
+    }
+    if (cson__query_keyword(c, "null")){
+        operand->literal.type = Cson_Null;
+        return true;
+    }
+    const char *begin = c->p;
+    while ((*c->p >= '0' && *c->p <= '9') || *c->p == '-' || *c->p == '+' || *c->p == '.' || *c->p == 'e' || *c->p == 'E') c->p++;
+    CsonNumber number;
+    switch (cson__lex_number((char*) begin, (char*) c->p, &number)){
+        case CsonToken_Int: operand->literal = (Cson) {.value.integer=number.integer, .type=Cson_Int}; return true;
+        case CsonToken_Float: operand->literal = (Cson) {.value.floating=number.floating, .type=Cson_Float}; return true;
+        default:{
+            c->p = begin;
+            return cson__query_fail(c, "Expected a value");
+        }
+    }
+}
+
+static bool cson__query_unary(CsonQueryCompiler *c, size_t *out)
+{
+    cson__query_skip(c);
+    if (*c->p == '!'){
+        c->p++;
+        size_t operand;
+        if (!cson__query_unary(c, &operand)) return false;
+        *out = cson__query_expr(c, (CsonExpr) {.type=CsonExpr_Not, .left=operand});
+        return true;
+    }
+    if (*c->p == '('){
+        c->p++;
+        if (!cson__query_or(c, out)) return false;
+        cson__query_skip(c);
+        if (*c->p != ')') return cson__query_fail(c, "Expected ')'");
+        c->p++;
+        return true;
+    }
+    CsonExpr expr = {.type=CsonExpr_Exists};
+    if (!cson__query_operand(c, &expr.operands[0])) return false;
+    cson__query_skip(c);
+    static const char *const ops[] = {
+        [CsonCompare_Eq] = "==",
+        [CsonCompare_Ne] = "!=",
+        [CsonCompare_Le] = "<=",
+        [CsonCompare_Ge] = ">=",
+        [CsonCompare_Lt] = "<",
+        [CsonCompare_Gt] = ">",
+    };
+    // the two character operators are tested first
+    static const CsonCompareOp order[] = {CsonCompare_Eq, CsonCompare_Ne, CsonCompare_Le, CsonCompare_Ge, CsonCompare_Lt, CsonCompare_Gt};
+    for (size_t i=0; i<cson_arr_len(order) && expr.type == CsonExpr_Exists; ++i){
+        size_t len = strlen(ops[order[i]]);
+        if (strncmp(c->p, ops[order[i]], len) == 0){
+            expr.type = CsonExpr_Compare;
+            expr.op = order[i];
+            c->p += len;
+        }
+    }
+    if (expr.type == CsonExpr_Exists){
+        if (expr.operands[0].path == NULL) return cson__query_fail(c, "Expected a comparison");
+    }
+    else{
+        cson__query_skip(c);
+        if (!cson__query_operand(c, &expr.operands[1])){
+            cson_path_free(expr.operands[0].path);
+            return false;
+        }
+    }
+    *out = cson__query_expr(c, expr);
+    return true;
+}
+
+static bool cson__query_and(CsonQueryCompiler *c, size_t *out)
+{
+    if (!cson__query_unary(c, out)) return false;
+    cson__query_skip(c);
+    while (c->p[0] == '&' && c->p[1] == '&'){
+        c->p += 2;
+        size_t right;
+        if (!cson__query_unary(c, &right)) return false;
+        *out = cson__query_expr(c, (CsonExpr) {.type=CsonExpr_And, .left=*out, .right=right});
+        cson__query_skip(c);
+    }
+    return true;
+}
+
+static bool cson__query_or(CsonQueryCompiler *c, size_t *out)
+{
+    if (!cson__query_and(c, out)) return false;
+    cson__query_skip(c);
+    while (c->p[0] == '|' && c->p[1] == '|'){
+        c->p += 2;
+        size_t right;
+        if (!cson__query_and(c, &right)) return false;
+        *out = cson__query_expr(c, (CsonExpr) {.type=CsonExpr_Or, .left=*out, .right=right});
+        cson__query_skip(c);
+    }
+    return true;
+}
+
+static bool cson__query_selector(CsonQueryCompiler *c, CsonSelector *selector)
+{
+    *selector = (CsonSelector) {.step=1};
+    if (*c->p == '*'){
+        c->p++;
+        selector->type = CsonSelector_Wildcard;
+        return true;
+    }
+    if (*c->p == '\'' || *c->p == '"'){
+        selector->type = CsonSelector_Name;
+        if (!cson__query_string(c, &selector->name)) return false;
+        selector->hash = cson_str_hash(selector->name);
+        return true;
+    }
+    if (*c->p == '?'){
+        c->p++;
+        selector->type = CsonSelector_Filter;
+        return cson__query_or(c, &selector->filter);
+    }
+    selector->type = CsonSelector_Index;
+    selector->has_start = cson__query_int(c, &selector->start);
+    cson__query_skip(c);
+    if (*c->p != ':'){
+        return selector->has_start || cson__query_fail(c, "Expected a selector");
+    }
+    selector->type = CsonSelector_Slice;
+    c->p++;
+    cson__query_skip(c);
+    selector->has_end = cson__query_int(c, &selector->end);
+    cson__query_skip(c);
+    if (*c->p == ':'){
+        c->p++;
+        cson__query_skip(c);
+        if (!cson__query_int(c, &selector->step)) selector->step = 1;
+    }
+    return true;
+}
+
+static void cson__query_add_selector(CsonQuery *query, CsonSelector selector)
+{
+    query->selectors = cson__query_grow(query->selectors, query->selector_count, sizeof(*query->selectors));
+    query->selectors[query->selector_count++] = selector;
+}
+
+CsonQuery* cson_query_compile(const char *expression)
+{
+    if (expression == NULL) return NULL;
+    CsonQuery *query = calloc(1, sizeof(*query));
+    cson_assert_alloc(query);
+    query->strings = malloc(strlen(expression)+1);
+    cson_assert_alloc(query->strings);
+    CsonQueryCompiler c = {.expression=expression, .p=expression, .query=query, .strings=query->strings};
+    cson__query_skip(&c);
+    if (*c.p++ != '$'){
+        c.p--;
+        cson__query_fail(&c, "Expected '$'");
+        goto error;
+    }
+    while (cson__query_skip(&c), *c.p != '\0'){
+        CsonSegment segment = {.first=query->selector_count};
+        CsonSelector selector = {0};
+        bool dotted = false;
+        if (c.p[0] == '.' && c.p[1] == '.'){
+            segment.descendant = true;
+            c.p += 2;
+            dotted = (*c.p != '[');
+        }
+        else if (*c.p == '.'){
+            c.p++;
+            dotted = true;
+        }
+        else if (*c.p != '['){
+            cson__query_fail(&c, "Expected a segment");
+            goto error;
+        }
+        if (dotted){
+            if (*c.p == '*'){
+                c.p++;
+                selector.type = CsonSelector_Wildcard;
+            }
+            else{
+                selector.type = CsonSelector_Name;
+                // quotes are not allowed after a dot
+                if (*c.p == '\'' || *c.p == '"' || !cson__query_string(&c, &selector.name)){
+                    cson__query_fail(&c, "Expected a name");
+                    goto error;
+                }
+                selector.hash = cson_str_hash(selector.name);
+            }
+            cson__query_add_selector(query, selector);
+        }
+        else{
+            c.p++;
+            while (true){
+                cson__query_skip(&c);
+                if (!cson__query_selector(&c, &selector)) goto error;
+                cson__query_add_selector(query, selector);
+                cson__query_skip(&c);
+                if (*c.p == ']') break;
+                if (*c.p++ != ','){
+                    c.p--;
+                    cson__query_fail(&c, "Expected ',' or ']'");
+                    goto error;
                 }
             }
+            c.p++;
+        }
+        segment.count = query->selector_count - segment.first;
+        query->segments = cson__query_grow(query->segments, query->segment_count, sizeof(*query->segments));
+        query->segments[query->segment_count++] = segment;
+    }
+    return query;
+error:
+    cson_query_free(query);
+    return NULL;
+}
+
+void cson_query_free(CsonQuery *query)
+{
+    if (query == NULL) return;
+    for (size_t i=0; i<query->expr_count; ++i){
+        cson_path_free(query->exprs[i].operands[0].path);
+        cson_path_free(query->exprs[i].operands[1].path);
+    }
+    free(query->segments);
+    free(query->selectors);
+    free(query->exprs);
+    free(query->strings);
+    free(query);
+}
+
+// the child at *position or the first one after it, *position is moved past it
+static Cson* cson__query_child(Cson *node, size_t *position)
+{
+    if (node->type == Cson_Array) return (*position < node->value.array->size)? cson__array_at(node->value.array, (*position)++):NULL;
+    if (node->type == Cson_Map){
+        CsonMapItem *item = cson__map_next(node->value.map, position);
+        return (item != NULL)? item->value:NULL;
+    }
+    return NULL;
+}
+
+// like cson_path_get, but a missing value is no error in a filter
+static Cson* cson__query_resolve(Cson *cson, CsonPath *path)
+{
+    for (size_t i=0; i<path->count && cson != NULL; ++i){
+        CsonPathStep *step = &path->steps[i];
+        if (step->is_key && cson->type == Cson_Map) cson = cson__map_get(cson, step->key, step->hash);
+        else if (step->index != SIZE_MAX && cson->type == Cson_Array) cson = cson_array_get(cson, step->index);
+        else return NULL;
+    }
+    return cson;
+}
+
+// missing values (NULL) are only equal to each other, containers are compared by identity
+static bool cson__query_compare(Cson *a, Cson *b, CsonCompareOp op)
+{
+    bool equal;
+    bool ordered = false;
+    int order = 0;
+    if (a == NULL || b == NULL){
+        equal = (a == b);
+    }
+    else if ((a->type == Cson_Int || a->type == Cson_Float) && (b->type == Cson_Int || b->type == Cson_Float)){
+        if (a->type == Cson_Int && b->type == Cson_Int){
+            order = (a->value.integer > b->value.integer) - (a->value.integer < b->value.integer);
+        }
+        else{
+            double x = (a->type == Cson_Int)? (double) a->value.integer:a->value.floating;
+            double y = (b->type == Cson_Int)? (double) b->value.integer:b->value.floating;
+            order = (x > y) - (x < y);
+        }
+        ordered = true;
+        equal = (order == 0);
+    }
+    else if (a->type != b->type){
+        equal = false;
+    }
+    else{
+        switch (a->type){
+            case Cson_String:{
+                CsonStr x = cson__to_string(a), y = cson__to_string(b);
+                int cmp = memcmp(x.value, y.value, (x.len < y.len)? x.len:y.len);
+                order = (cmp != 0)? (cmp > 0) - (cmp < 0):(x.len > y.len) - (x.len < y.len);
+                ordered = true;
+                equal = (order == 0);
+            }break;
+            case Cson_Bool: equal = (a->value.boolean == b->value.boolean); break;
+            case Cson_Null: equal = true; break;
+            default: equal = (a == b);
+        }
+    }
+    switch (op){
+        case CsonCompare_Eq: return equal;
+        case CsonCompare_Ne: return !equal;
+        case CsonCompare_Lt: return ordered && order < 0;
+        case CsonCompare_Le: return (ordered && order < 0) || equal;
+        case CsonCompare_Gt: return ordered && order > 0;
+        case CsonCompare_Ge: return (ordered && order > 0) || equal;
+    }
+    return false;
+}
+
+static Cson* cson__query_value(CsonQueryIter *iter, CsonOperand *operand, Cson *current)
+{
+    if (operand->path == NULL) return &operand->literal;
+    return cson__query_resolve(operand->absolute? iter->root:current, operand->path);
+}
+
+static bool cson__query_test(CsonQueryIter *iter, size_t index, Cson *current)
+{
+    CsonExpr *expr = &iter->query->exprs[index];
+    switch (expr->type){
+        case CsonExpr_Or: return cson__query_test(iter, expr->left, current) || cson__query_test(iter, expr->right, current);
+        case CsonExpr_And: return cson__query_test(iter, expr->left, current) && cson__query_test(iter, expr->right, current);
+        case CsonExpr_Not: return !cson__query_test(iter, expr->left, current);
+        case CsonExpr_Exists: return cson__query_value(iter, &expr->operands[0], current) != NULL;
+        case CsonExpr_Compare: return cson__query_compare(cson__query_value(iter, &expr->operands[0], current), cson__query_value(iter, &expr->operands[1], current), expr->op);
+    }
+    return false;
+}
+
+// returns the next value selected from the node of frame, NULL when the selector is exhausted
+static Cson* cson__query_select(CsonQueryIter *iter, CsonQueryFrame *frame, CsonSelector *selector)
+{
+    Cson *node = frame->node;
+    switch (selector->type){
+        case CsonSelector_Name:{
+            if (frame->position++ > 0 || node->type != Cson_Map) return NULL;
+            return cson__map_get(node, selector->name, selector->hash);
+        }
+        case CsonSelector_Wildcard: return cson__query_child(node, &frame->position);
+        case CsonSelector_Index:{
+            if (frame->position++ > 0 || node->type != Cson_Array) return NULL;
+            int64_t len = (int64_t) node->value.array->size;
+            int64_t index = (selector->start < 0)? selector->start + len:selector->start;
+            return (index >= 0 && index < len)? cson__array_at(node->value.array, (size_t) index):NULL;
+        }
+        case CsonSelector_Slice:{
+            if (node->type != Cson_Array || selector->step == 0) return NULL;
+            int64_t len = (int64_t) node->value.array->size;
+            int64_t step = selector->step;
+            int64_t start = selector->has_start? selector->start:((step > 0)? 0:len-1);
+            int64_t end = selector->has_end? selector->end:((step > 0)? len:-len-1);
+            if (selector->has_start && start < 0) start += len;
+            if (selector->has_end && end < 0) end += len;
+            // bounds are clamped as in python, the selected count is checked first so huge steps cannot overflow
+            uint64_t stride = (step > 0)? (uint64_t) step:0 - (uint64_t) step;
+            int64_t first, last;
+            if (step > 0){
+                first = (start < 0)? 0:(start > len)? len:start;
+                last = ((end < 0)? 0:(end > len)? len:end) - 1;
+            }
+            else{
+                first = (start < -1)? -1:(start > len-1)? len-1:start;
+                last = ((end < -1)? -1:(end > len-1)? len-1:end) + 1;
+            }
+            if ((step > 0)? last < first:last > first) return NULL;
+            uint64_t span = (step > 0)? (uint64_t) (last - first):(uint64_t) (first - last);
+            if (frame->position > span / stride) return NULL;
+            uint64_t offset = frame->position++ * stride;
+            size_t index = (step > 0)? (size_t) first + offset:(size_t) first - offset;
+            return cson__array_at(node->value.array, index);
+        }
+        case CsonSelector_Filter:{
+            Cson *child;
+            while ((child = cson__query_child(node, &frame->position)) != NULL){
+                if (cson__query_test(iter, selector->filter, child)) return child;
+            }
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+static void cson__query_push(CsonQueryIter *iter, Cson *node, size_t segment)
+{
+    if (iter->depth >= iter->capacity){
+        iter->capacity = (iter->capacity == 0)? 16:iter->capacity*2;
+        iter->stack = realloc(iter->stack, iter->capacity*sizeof(*iter->stack));
+        cson_assert_alloc(iter->stack);
+    }
+    iter->stack[iter->depth++] = (CsonQueryFrame) {.node=node, .segment=segment};
+}
+
+CsonQueryIter cson_query_iter(CsonQuery *query, Cson *cson)
+{
+    CsonQueryIter iter = {.query=query, .root=cson};
+    if (query != NULL && cson != NULL) cson__query_push(&iter, cson, 0);
+    return iter;
+}
+
+Cson* cson_query_next(CsonQueryIter *iter)
+{
+    if (iter == NULL) return NULL;
+    CsonQuery *query = iter->query;
+    while (iter->depth > 0){
+        CsonQueryFrame *frame = &iter->stack[iter->depth-1];
+        // a node that passed every segment is a match
+        if (frame->segment == query->segment_count){
+            iter->depth--;
+            return frame->node;
+        }
+        CsonSegment *segment = &query->segments[frame->segment];
+        Cson *next = NULL;
+        if (!frame->descending){
+            while (frame->selector < segment->count){
+                next = cson__query_select(iter, frame, &query->selectors[segment->first + frame->selector]);
+                if (next != NULL) break;
+                frame->selector++;
+                frame->position = 0;
+            }
+            if (next != NULL){
+                cson__query_push(iter, next, frame->segment+1);
+                continue;
+            }
+            if (!segment->descendant){
+                iter->depth--;
+                continue;
+            }
+            frame->descending = true;
+            frame->position = 0;
+        }
+        // a descendant segment is applied to every child in document order
+        next = cson__query_child(frame->node, &frame->position);
+        if (next == NULL) iter->depth--;
+        else cson__query_push(iter, next, frame->segment);
+    }
+    return NULL;
+}
+
+void cson_query_iter_free(CsonQueryIter *iter)
+{
+    if (iter == NULL) return;
+    free(iter->stack);
+    *iter = (CsonQueryIter) {0};
+}
+
+/* Lazy parser implementation */
+
+bool cson_lazy_init(CsonLazyDoc *doc, char *buffer, size_t buffer_size, char *filename)
+{
+    if (doc == NULL || buffer == NULL) return false;
+    if (buffer_size > UINT32_MAX){
+        cson_error(CsonError_InvalidParam, "Buffer is too large for lazy parsing: \"%s\"", filename);
+        return false;
+    }
+    doc->buffer = buffer;
+    doc->buffer_size = buffer_size;
+    doc->filename = filename;
+    doc->count = 0;
+    CsonLexer lexer = cson_lex_init(buffer, buffer_size, filename);
+    // the windows are indexed straight into the entry array, so the lexer never allocates
+    while (lexer.indexed < buffer_size){
+        size_t window = (buffer_size - lexer.indexed > CSON_INDEX_WINDOW)? CSON_INDEX_WINDOW:buffer_size - lexer.indexed;
+        if (doc->count + window > doc->capacity){
+            size_t capacity = (doc->capacity*2 > doc->count + window)? doc->capacity*2:doc->count + window;
+            uint32_t *entries = realloc(doc->entries, capacity*sizeof(*entries));
+            cson_assert_alloc(entries);
+            doc->entries = entries;
+            doc->capacity = capacity;
+        }
+        lexer.structurals = doc->entries + doc->count;
+        (void) cson__lex_index_window(&lexer);
+        for (size_t i=0; i<lexer.structural_count; ++i){
+            lexer.structurals[i] += (uint32_t) lexer.structural_base;
+        }
+        doc->count += lexer.structural_count;
+    }
+    return true;
+}
+
+void cson_lazy_free(CsonLazyDoc *doc)
+{
+    if (doc == NULL) return;
+    free(doc->entries);
+    *doc = (CsonLazyDoc) {0};
+}
+
+CsonLazy cson_lazy_root(CsonLazyDoc *doc)
+{
+    if (doc == NULL || doc->count == 0) return (CsonLazy) {0};
+    return (CsonLazy) {.doc=doc, .entry=0};
+}
+
+// the character of an index entry, '\0' past the last entry
+static char cson__lazy_char(CsonLazyDoc *doc, size_t entry)
+{
+    return (entry < doc->count)? doc->buffer[doc->entries[entry]]:'\0';
+}
+
+// the first character of an index entry, NULL past the last entry
+static char* cson__lazy_start(CsonLazyDoc *doc, size_t entry)
+{
+    return (entry < doc->count)? doc->buffer + doc->entries[entry]:NULL;
+}
+
+// returns the entry following the value that starts at entry
+static size_t cson__lazy_skip(CsonLazyDoc *doc, size_t entry)
+{
+    char c = cson__lazy_char(doc, entry);
+    if (c == '"') return entry+2;
+    if (c != '{' && c != '[') return entry+1;
+    // strings contain no entries, so matching the brackets is enough
+    size_t depth = 0;
+    for (; entry < doc->count; ++entry){
+        switch (doc->buffer[doc->entries[entry]]){
+            case '{':
+            case '[': depth++; break;
+            case '}':
+            case ']':{
+                if (--depth == 0) return entry+1;
+            }break;
+            default: break;
+        }
+    }
+    return doc->count;
+}
+
+// the end of a literal is not an index entry
+static char* cson__lazy_literal_end(CsonLazyDoc *doc, size_t entry)
+{
+    char *p = doc->buffer + doc->entries[entry];
+    char *end = doc->buffer + doc->buffer_size;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r' && *p != ',' && *p != ']' && *p != '}' && *p != ':') p++;
+    return p;
+}
+
+static CsonLazy cson__lazy_fail(CsonLazyDoc *doc, size_t entry, const char *expected)
+{
+    cson_error(CsonError_UnexpectedToken, "%s:%zu: expected %s", doc->filename, (size_t) ((entry < doc->count)? doc->entries[entry]:doc->buffer_size), expected);
+    (void) doc;
+    (void) entry;
+    (void) expected;
+    return (CsonLazy) {0};
+}
+
+CsonType cson_lazy_type(CsonLazy value)
+{
+    if (value.doc == NULL) return Cson__TypeCount;
+    switch (cson__lazy_char(value.doc, value.entry)){
+        case '{': return Cson_Map;
+        case '[': return Cson_Array;
+        case '"': return Cson_String;
+        case 't':
+        case 'f': return Cson_Bool;
+        case 'n': return Cson_Null;
+        case '\0': return Cson__TypeCount;
+        default:{
+            CsonNumber number;
+            char *start = cson__lazy_start(value.doc, value.entry);
+            switch (cson__lex_number(start, cson__lazy_literal_end(value.doc, value.entry), &number)){
+                case CsonToken_Int: return Cson_Int;
+                case CsonToken_Float: return Cson_Float;
+                default: return Cson__TypeCount;
+            }
+        }
+    }
+}
+
+CsonLazy cson_lazy_key(CsonLazy map, CsonStr key)
+{
+    CsonLazyDoc *doc = map.doc;
+    if (doc == NULL || key.value == NULL || cson__lazy_char(doc, map.entry) != '{') return (CsonLazy) {0};
+    size_t entry = map.entry+1;
+    if (cson__lazy_char(doc, entry) == '}') return (CsonLazy) {0};
+    while (true){
+        if (cson__lazy_char(doc, entry) != '"' || cson__lazy_char(doc, entry+1) != '"') return cson__lazy_fail(doc, entry, "a key");
+        if (cson__lazy_char(doc, entry+2) != ':') return cson__lazy_fail(doc, entry+2, "':'");
+        char *raw = doc->buffer + doc->entries[entry] + 1;
+        size_t raw_len = doc->entries[entry+1] - doc->entries[entry] - 1;
+        bool match;
+        if (memchr(raw, '\\', raw_len) == NULL){
+            match = (raw_len == key.len && memcmp(raw, key.value, raw_len) == 0);
+        }
+        else{
+            // escaped keys are rare, they are decoded for the comparison
+            char *decoded = malloc(raw_len);
+            cson_assert_alloc(decoded);
+            size_t len = cson_lex_unescape(decoded, raw, raw_len);
+            match = (len == key.len && memcmp(decoded, key.value, len) == 0);
+            free(decoded);
+        }
+        entry += 3;
+        if (match){
+            // a truncated document can end right after the ':'
+            if (entry >= doc->count) return cson__lazy_fail(doc, entry, "a value");
+            return (CsonLazy) {.doc=doc, .entry=entry};
+        }
+        entry = cson__lazy_skip(doc, entry);
+        char c = cson__lazy_char(doc, entry++);
+        if (c == '}') return (CsonLazy) {0};
+        if (c != ',') return cson__lazy_fail(doc, entry-1, "',' or '}'");
+    }
+}
+
+CsonLazy cson_lazy_index(CsonLazy array, size_t index)
+{
+    CsonLazyDoc *doc = array.doc;
+    if (doc == NULL || cson__lazy_char(doc, array.entry) != '[') return (CsonLazy) {0};
+    size_t entry = array.entry+1;
+    if (cson__lazy_char(doc, entry) == ']') return (CsonLazy) {0};
+    for (size_t i=0; i<index; ++i){
+        entry = cson__lazy_skip(doc, entry);
+        char c = cson__lazy_char(doc, entry++);
+        if (c == ']') return (CsonLazy) {0};
+        if (c != ',') return cson__lazy_fail(doc, entry-1, "',' or ']'");
+    }
+    if (entry >= doc->count) return cson__lazy_fail(doc, entry, "a value");
+    return (CsonLazy) {.doc=doc, .entry=entry};
+}
+
+size_t cson_lazy_len(CsonLazy value)
+{
+    CsonLazyDoc *doc = value.doc;
+    if (doc == NULL) return 0;
+    char open = cson__lazy_char(doc, value.entry);
+    if (open != '{' && open != '[') return 0;
+    size_t entry = value.entry+1;
+    char close = (open == '{')? '}':']';
+    if (cson__lazy_char(doc, entry) == close) return 0;
+    size_t len = 1;
+    while (true){
+        // a map member is a key, a ':' and the value
+        if (open == '{') entry += 3;
+        entry = cson__lazy_skip(doc, entry);
+        char c = cson__lazy_char(doc, entry++);
+        if (c == close) return len;
+        if (c != ','){
+            cson__lazy_fail(doc, entry-1, "a separator");
+            return 0;
+        }
+        len++;
+    }
+}
+
+Cson* cson_lazy_build(CsonLazy value)
+{
+    CsonLazyDoc *doc = value.doc;
+    if (doc == NULL) return NULL;
+    char *start = cson__lazy_start(doc, value.entry);
+    if (start == NULL) return NULL;
+    char c = *start;
+    if (c == '{' || c == '['){
+        size_t close = cson__lazy_skip(doc, value.entry) - 1;
+        size_t end = (close < doc->count)? doc->entries[close] + 1:doc->buffer_size;
+        return cson__parse(cson_current_arena, start, end - (start - doc->buffer), doc->filename, false);
+    }
+    // the parser only accepts containers, scalars are built from a single token
+    CsonToken token;
+    CsonLoc loc = {.filename=doc->filename};
+    if (c == '"'){
+        if (cson__lazy_char(doc, value.entry+1) != '"') return NULL;
+        cson_lex_set_token(&token, CsonToken_String, start+1, doc->buffer + doc->entries[value.entry+1], loc);
+    }
+    else{
+        cson_lex_set_token(&token, CsonToken_Invalid, start, cson__lazy_literal_end(doc, value.entry), loc);
+        if (cson__lex_literal(&token) == CsonToken_Invalid){
+            cson__lazy_fail(doc, value.entry, "a value");
+            return NULL;
+        }
+    }
+    Cson *cson = cson__new(cson_current_arena);
+    cson__build_scalar(cson, cson_current_arena, &token, false);
+    return cson;
+}
+
+CsonLazy cson__lazy_get(CsonLazy value, CsonArg args[], size_t count)
+{
+    for (size_t i=0; i<count && value.doc != NULL; ++i){
+        value = (args[i].type == CsonArg_Key)? cson_lazy_key(value, args[i].value.key):cson_lazy_index(value, args[i].value.index);
+    }
+    return value;
+}
+
+static bool cson__lazy_number(CsonLazy value, CsonNumber *number, CsonTokenType type)
+{
+    if (value.doc == NULL) return false;
+    char *start = cson__lazy_start(value.doc, value.entry);
+    if (start == NULL) return false;
+    return cson__lex_number(start, cson__lazy_literal_end(value.doc, value.entry), number) == type;
+}
+
+bool cson__lazy_get_int(int64_t *out, CsonLazy value)
+{
+    CsonNumber number;
+    if (out == NULL || !cson__lazy_number(value, &number, CsonToken_Int)) return false;
+    *out = number.integer;
+    return true;
+}
+
+bool cson__lazy_get_float(double *out, CsonLazy value)
+{
+    CsonNumber number;
+    if (out == NULL || !cson__lazy_number(value, &number, CsonToken_Float)) return false;
+    *out = number.floating;
+    return true;
+}
+
+bool cson__lazy_get_bool(bool *out, CsonLazy value)
+{
+    if (out == NULL || value.doc == NULL) return false;
+    char *start = cson__lazy_start(value.doc, value.entry);
+    if (start == NULL) return false;
+    size_t len = cson__lazy_literal_end(value.doc, value.entry) - start;
+    if (len == 4 && memcmp(start, "true", 4) == 0) *out = true;
+    else if (len == 5 && memcmp(start, "false", 5) == 0) *out = false;
+    else return false;
+    return true;
+}
+
+bool cson__lazy_get_string(CsonStr *out, CsonLazy value)
+{
+    CsonLazyDoc *doc = value.doc;
+    if (out == NULL || doc == NULL || cson__lazy_char(doc, value.entry) != '"' || cson__lazy_char(doc, value.entry+1) != '"') return false;
+    CsonToken token;
+    cson_lex_set_token(&token, CsonToken_String, doc->buffer + doc->entries[value.entry] + 1, doc->buffer + doc->entries[value.entry+1], (CsonLoc) {.filename=doc->filename});
+    *out = cson__parse_string(cson_current_arena, &token, false);
+    return true;
+}
+
+bool cson__lazy_get_cstring(char **out, CsonLazy value)
+{
+    CsonStr str;
+    if (out == NULL || !cson__lazy_get_string(&str, value)) return false;
+    *out = str.value;
+    return true;
+}
+
+/* Tape implementation */
+
+typedef enum{
+    CsonTape_Int = 'l', // the value follows in the next slot
+    CsonTape_Float = 'd', // the value follows in the next slot
+    CsonTape_True = 't',
+    CsonTape_False = 'f',
+    CsonTape_Null = 'n',
+    CsonTape_String = '"', // payload: offset into the strings
+    CsonTape_MapOpen = '{', // payload: slot after the close and the number of members
+    CsonTape_MapClose = '}', // payload: slot of the open
+    CsonTape_ArrayOpen = '[',
+    CsonTape_ArrayClose = ']',
+} CsonTapeTag;
+
+#define CSON__TAPE_PAYLOAD_MASK 0x00FFFFFFFFFFFFFFull
+#define CSON__TAPE_COUNT_MAX 0xFFFFFF
+#define cson__tape_slot(tag, payload) (((uint64_t) (tag) << 56) | (payload))
+#define cson__tape_tag(tape, slot) ((uint8_t) ((tape)->slots[slot] >> 56))
+#define cson__tape_payload(tape, slot) ((tape)->slots[slot] & CSON__TAPE_PAYLOAD_MASK)
+// a container open stores the slot after its close in the low 32 bits and the saturated member count above
+#define cson__tape_end(tape, slot) ((size_t) (cson__tape_payload(tape, slot) & 0xFFFFFFFF))
+
+static uint64_t* cson__tape_reserve(CsonTape *tape, size_t count)
+{
+    if (tape->count + count > tape->capacity){
+        size_t capacity = (tape->capacity == 0)? 1024:tape->capacity*2;
+        while (capacity < tape->count + count) capacity *= 2;
+        uint64_t *slots = realloc(tape->slots, capacity*sizeof(*slots));
+        cson_assert_alloc(slots);
+        tape->slots = slots;
+        tape->capacity = capacity;
+    }
+    return tape->slots + tape->count;
+}
+
+static void cson__tape_string(CsonTape *tape, CsonToken *token)
+{
+    size_t needed = tape->strings_size + sizeof(uint32_t) + token->len + 1;
+    if (needed > tape->strings_capacity){
+        size_t capacity = (tape->strings_capacity == 0)? 4096:tape->strings_capacity*2;
+        while (capacity < needed) capacity *= 2;
+        char *strings = realloc(tape->strings, capacity);
+        cson_assert_alloc(strings);
+        tape->strings = strings;
+        tape->strings_capacity = capacity;
+    }
+    char *out = tape->strings + tape->strings_size;
+    uint32_t len = (uint32_t) cson_lex_unescape(out + sizeof(uint32_t), token->t_start, token->len);
+    memcpy(out, &len, sizeof(len));
+    out[sizeof(len) + len] = '\0';
+    *cson__tape_reserve(tape, 1) = cson__tape_slot(CsonTape_String, tape->strings_size);
+    tape->count++;
+    tape->strings_size += sizeof(len) + len + 1;
+}
+
+// returns false if the tape has grown past the slots a container open can refer to
+static bool cson__tape_event(CsonTape *tape, size_t *depth, CsonEvent event, CsonToken *token)
+{
+    // every value but a key counts as a member of its container
+    if (*depth > 0 && (event == CsonEvent_Value || event == CsonEvent_BeginMap || event == CsonEvent_BeginArray)){
+        tape->frames[*depth-1].count++;
+    }
+    switch (event){
+        case CsonEvent_BeginMap:
+        case CsonEvent_BeginArray:{
+            if (*depth >= tape->frame_capacity){
+                size_t capacity = (tape->frame_capacity == 0)? 64:tape->frame_capacity*2;
+                CsonTapeFrame *frames = realloc(tape->frames, capacity*sizeof(*frames));
+                cson_assert_alloc(frames);
+                tape->frames = frames;
+                tape->frame_capacity = capacity;
+            }
+            tape->frames[(*depth)++] = (CsonTapeFrame) {.open=tape->count};
+            *cson__tape_reserve(tape, 1) = cson__tape_slot((event == CsonEvent_BeginMap)? CsonTape_MapOpen:CsonTape_ArrayOpen, 0);
+            tape->count++;
+        }break;
+        case CsonEvent_EndMap:
+        case CsonEvent_EndArray:{
+            CsonTapeFrame frame = tape->frames[--(*depth)];
+            *cson__tape_reserve(tape, 1) = cson__tape_slot((event == CsonEvent_EndMap)? CsonTape_MapClose:CsonTape_ArrayClose, frame.open);
+            tape->count++;
+            if (tape->count > UINT32_MAX){
+                cson_error(CsonError_InvalidParam, CSON_LOC_FMT": document is too large for a tape", cson_loc_expand(cson_token_loc(token)));
+                return false;
+            }
+            size_t count = (frame.count < CSON__TAPE_COUNT_MAX)? frame.count:CSON__TAPE_COUNT_MAX;
+            tape->slots[frame.open] |= ((uint64_t) count << 32) | (uint64_t) tape->count;
+        }break;
+        case CsonEvent_Key:{
+            cson__tape_string(tape, token);
+        }break;
+        case CsonEvent_Value:{
+            switch (token->type){
+                case CsonToken_String: cson__tape_string(tape, token); break;
+                case CsonToken_Int:
+                case CsonToken_Float:{
+                    uint64_t *slots = cson__tape_reserve(tape, 2);
+                    slots[0] = cson__tape_slot((token->type == CsonToken_Int)? CsonTape_Int:CsonTape_Float, 0);
+                    memcpy(&slots[1], &token->number, sizeof(slots[1]));
+                    tape->count += 2;
+                }break;
+                case CsonToken_True: *cson__tape_reserve(tape, 1) = cson__tape_slot(CsonTape_True, 0); tape->count++; break;
+                case CsonToken_False: *cson__tape_reserve(tape, 1) = cson__tape_slot(CsonTape_False, 0); tape->count++; break;
+                default: *cson__tape_reserve(tape, 1) = cson__tape_slot(CsonTape_Null, 0); tape->count++;
+            }
+        }break;
+        default: break;
+    }
+    return true;
+}
+
+bool cson_tape_parse(CsonTape *tape, char *buffer, size_t buffer_size, char *filename)
+{
+    if (tape == NULL || buffer == NULL || buffer_size == 0) return false;
+    tape->count = 0;
+    tape->strings_size = 0;
+    CsonLexer lexer = cson_lex_init(buffer, buffer_size, filename);
+    lexer.structurals = tape->structurals;
+    (void) cson_lex_index(&lexer);
+    CsonGrammar grammar = {.stack=tape->grammar_stack, .capacity=tape->grammar_capacity};
+    CsonToken token;
+    CsonEvent event;
+    size_t depth = 0;
+    bool success = false;
+    while (true){
+        token.type = CsonToken_Invalid;
+        if (!cson_lex_next(&lexer, &token)){
+            if (token.type != CsonToken_End) break;
+            if (grammar.state == CsonGrammar_Value && grammar.depth == 0){
+                cson_error(CsonError_EndOfBuffer, "file is empty: \"%s\"", filename);
+            }
             else{
-                *w = *r;
+                success = cson__grammar_end(&grammar, &token) == CsonError_Success;
             }
-            r++;
-            w++;
+            break;
         }
-        sprintf(buffer, "%.*s", w-temp_buffer+1, temp_buffer);
-    }
-    else{
-        sprintf(buffer, "%.*s", token->len, token->t_start);
+        if (cson__grammar_step(&grammar, &token, &event) != CsonError_Success) break;
+        if (!cson__tape_event(tape, &depth, event, &token)) break;
     }
-    return true;
+    tape->structurals = lexer.structurals;
+    tape->grammar_stack = grammar.stack;
+    tape->grammar_capacity = grammar.capacity;
+    if (!success) tape->count = 0;
+    return success;
 }
 
-void cson_lex_print(CsonToken token)
+void cson_tape_free(CsonTape *tape)
 {
-    cson_info(CSON_LOC_FMT": %s: '%.*s'\n", cson_loc_expand(token.loc), CsonTokenTypeNames[token.type], token.t_end-token.t_start, token.t_start);
+    if (tape == NULL) return;
+    free(tape->slots);
+    free(tape->strings);
+    free(tape->frames);
+    free(tape->structurals);
+    free(tape->grammar_stack);
+    *tape = (CsonTape) {0};
 }
 
-void cson_lex_set_token(CsonToken *token, CsonTokenType type, char *t_start, char *t_end, CsonLoc loc)
+CsonTapeRef cson_tape_root(CsonTape *tape)
 {
-    if (token == NULL) return;
-    token->type = type;
-    token->t_start = t_start;
-    token->t_end = t_end,
-    token->len = t_end-t_start,
-    token->loc = loc;
+    if (tape == NULL || tape->count == 0) return (CsonTapeRef) {0};
+    return (CsonTapeRef) {.tape=tape, .slot=0};
 }
 
-bool cson_lex_find(CsonLexer *lexer, char c)
+// the slot after the value at slot
+static size_t cson__tape_after(CsonTape *tape, size_t slot)
 {
-    char rc;
-    while (lexer->index < lexer->buffer_size){
-        if ((rc = cson_lex_get_char(lexer)) == c) return true;
-        cson_lex_check_line(lexer, rc);
-        lexer->index++;
+    switch (cson__tape_tag(tape, slot)){
+        case CsonTape_MapOpen:
+        case CsonTape_ArrayOpen: return cson__tape_end(tape, slot);
+        case CsonTape_Int:
+        case CsonTape_Float: return slot+2;
+        default: return slot+1;
     }
-    return false;
 }
 
-void cson_lex_trim_left(CsonLexer *lexer)
+CsonType cson_tape_type(CsonTapeRef ref)
 {
-    char c;
-    while (lexer->index <= lexer->buffer_size && cson_lex_is_whitespace((c = cson_lex_get_char(lexer)))){
-        cson_lex_check_line(lexer, c);
-        lexer->index++;
+    if (ref.tape == NULL) return Cson__TypeCount;
+    switch (cson__tape_tag(ref.tape, ref.slot)){
+        case CsonTape_Int: return Cson_Int;
+        case CsonTape_Float: return Cson_Float;
+        case CsonTape_True:
+        case CsonTape_False: return Cson_Bool;
+        case CsonTape_String: return Cson_String;
+        case CsonTape_MapOpen: return Cson_Map;
+        case CsonTape_ArrayOpen: return Cson_Array;
+        case CsonTape_Null: return Cson_Null;
+        default: return Cson__TypeCount;
     }
 }
 
-bool cson_lex_is_delimeter(char c)
+CsonTapeRef cson_tape_first(CsonTapeRef container)
 {
-    switch (c){
-        case '{':
-        case '}':
-        case '[':
-        case ']':
-        case ',':
-        case ':':
-        case ' ':
-        case '\n':
-        case '\t':{
-            return true;
+    CsonType type = cson_tape_type(container);
+    if (type != Cson_Map && type != Cson_Array) return (CsonTapeRef) {0};
+    uint8_t tag = cson__tape_tag(container.tape, container.slot+1);
+    if (tag == CsonTape_MapClose || tag == CsonTape_ArrayClose) return (CsonTapeRef) {0};
+    return (CsonTapeRef) {.tape=container.tape, .slot=container.slot+1};
+}
+
+CsonTapeRef cson_tape_next(CsonTapeRef ref)
+{
+    if (ref.tape == NULL) return (CsonTapeRef) {0};
+    size_t next = cson__tape_after(ref.tape, ref.slot);
+    if (next >= ref.tape->count) return (CsonTapeRef) {0};
+    uint8_t tag = cson__tape_tag(ref.tape, next);
+    if (tag == CsonTape_MapClose || tag == CsonTape_ArrayClose) return (CsonTapeRef) {0};
+    return (CsonTapeRef) {.tape=ref.tape, .slot=next};
+}
+
+size_t cson_tape_len(CsonTapeRef ref)
+{
+    CsonType type = cson_tape_type(ref);
+    if (type != Cson_Map && type != Cson_Array) return 0;
+    size_t count = (size_t) (cson__tape_payload(ref.tape, ref.slot) >> 32);
+    if (count < CSON__TAPE_COUNT_MAX) return count;
+    // the count saturated, the members are counted
+    count = 0;
+    for (CsonTapeRef item = cson_tape_first(ref); item.tape != NULL; item = cson_tape_next(item)){
+        count++;
+    }
+    return (type == Cson_Map)? count/2:count;
+}
+
+static CsonStr cson__tape_str(CsonTape *tape, size_t slot)
+{
+    char *data = tape->strings + cson__tape_payload(tape, slot);
+    uint32_t len;
+    memcpy(&len, data, sizeof(len));
+    return (CsonStr) {.value=data + sizeof(len), .len=len};
+}
+
+CsonTapeRef cson_tape_key(CsonTapeRef map, CsonStr key)
+{
+    if (cson_tape_type(map) != Cson_Map || key.value == NULL) return (CsonTapeRef) {0};
+    CsonTape *tape = map.tape;
+    size_t slot = map.slot+1;
+    CsonTapeRef found = {0};
+    // the tape keeps duplicate keys, the last one wins like in the tree
+    while (cson__tape_tag(tape, slot) == CsonTape_String){
+        CsonStr name = cson__tape_str(tape, slot);
+        if (name.len == key.len && memcmp(name.value, key.value, key.len) == 0){
+            found = (CsonTapeRef) {.tape=tape, .slot=slot+1};
         }
-        default: return false;
+        slot = cson__tape_after(tape, slot+1);
     }
+    return found;
 }
 
-bool cson_lex_is_int(char *s, char *e)
+CsonTapeRef cson_tape_index(CsonTapeRef array, size_t index)
 {
-    if (!s || !e || e-s < 1) return false;
-    if (*s == '-' || *s == '+') s++;
-    while (s < e){
-        if (!isdigit(*s++)) return false;
+    if (cson_tape_type(array) != Cson_Array || index >= cson_tape_len(array)) return (CsonTapeRef) {0};
+    CsonTape *tape = array.tape;
+    size_t slot = array.slot+1;
+    // containers are skipped in one step
+    for (size_t i=0; i<index; ++i){
+        slot = cson__tape_after(tape, slot);
+    }
+    return (CsonTapeRef) {.tape=tape, .slot=slot};
+}
+
+CsonTapeRef cson__tape_get(CsonTapeRef ref, CsonArg args[], size_t count)
+{
+    for (size_t i=0; i<count && ref.tape != NULL; ++i){
+        ref = (args[i].type == CsonArg_Key)? cson_tape_key(ref, args[i].value.key):cson_tape_index(ref, args[i].value.index);
     }
+    return ref;
+}
+
+bool cson__tape_get_int(int64_t *out, CsonTapeRef ref)
+{
+    if (out == NULL || cson_tape_type(ref) != Cson_Int) return false;
+    memcpy(out, &ref.tape->slots[ref.slot+1], sizeof(*out));
     return true;
 }
 
-bool cson_lex_is_float(char *s, char *e)
+bool cson__tape_get_float(double *out, CsonTapeRef ref)
 {
-    char* ep = NULL;
-    strtod(s, &ep);
-    return (ep && ep == e);
+    if (out == NULL || cson_tape_type(ref) != Cson_Float) return false;
+    memcpy(out, &ref.tape->slots[ref.slot+1], sizeof(*out));
+    return true;
 }
 
-void cson__error_unexpected(CsonLoc loc, CsonTokenType expected[], size_t expected_count, CsonTokenType actual, char *filename, size_t line)
+bool cson__tape_get_bool(bool *out, CsonTapeRef ref)
 {
-    if (expected_count == 0) return;
-    fprintf(stderr, "%s%s:%d [ERROR] (%s): Expected [", cson_ansi_rgb(196, 0, 0), filename, line, CsonErrorStrings[CsonError_UnexpectedToken]);
-    size_t i;
-    for (i=0; i<expected_count-1; ++i){
-        fprintf(stderr, "%s, ", CsonTokenTypeNames[expected[i]]);
-    }
-    fprintf(stderr, "%s], but got [%s] at "CSON_LOC_FMT CSON_ANSI_END"\n", CsonTokenTypeNames[expected[i]], CsonTokenTypeNames[actual], cson_loc_expand(loc));
+    if (out == NULL || cson_tape_type(ref) != Cson_Bool) return false;
+    *out = cson__tape_tag(ref.tape, ref.slot) == CsonTape_True;
+    return true;
 }
 
-/* Parser implementation */
+bool cson__tape_get_string(CsonStr *out, CsonTapeRef ref)
+{
+    if (out == NULL || cson_tape_type(ref) != Cson_String) return false;
+    *out = cson__tape_str(ref.tape, ref.slot);
+    return true;
+}
 
-bool cson__parse_map(Cson *map, CsonLexer *lexer)
+bool cson__tape_get_cstring(char **out, CsonTapeRef ref)
 {
-    if (map == NULL || map->type != Cson_Map || lexer == NULL) return false;
-    CsonToken token;
-    while (true){
-        cson_lex_next(lexer, &token);
-        switch (token.type){
-            case CsonToken_String: break;
-            case CsonToken_MapClose:{
-                if (cson_len(map) > 0){
-                    cson_error_unexpected(token.loc, token.type, CSON_VALUE_TOKENS);
-                    return false;
+    if (out == NULL || cson_tape_type(ref) != Cson_String) return false;
+    *out = cson__tape_str(ref.tape, ref.slot).value;
+    return true;
+}
+
+// a single pass over the slots, only a bit per open container is remembered
+CsonError cson_tape_serialize(CsonTapeRef ref, CsonBuf *buf, int flags)
+{
+    if (ref.tape == NULL || buf == NULL) return CsonError_InvalidParam;
+    CsonTape *tape = ref.tape;
+    bool pretty = (flags & CsonSerialize_Pretty) != 0;
+    uint64_t in_map[(CSON_MAX_DEPTH + 63)/64 + 1] = {0};
+    size_t depth = 0;
+    bool first = true; // no member has been written to the current container yet
+    bool value_next = false; // a map key has been written
+    size_t end = cson__tape_after(tape, ref.slot);
+    for (size_t slot = ref.slot; slot < end; ++slot){
+        uint8_t tag = cson__tape_tag(tape, slot);
+        if (tag == CsonTape_MapClose || tag == CsonTape_ArrayClose){
+            depth--;
+            if (pretty && !first) cson__serialize_newline(buf, depth);
+            cson__buf_push(buf, (char) tag);
+            first = false;
+            continue;
+        }
+        bool is_key = depth > 0 && (in_map[depth/64] >> (depth%64) & 1) && !value_next;
+        if (depth > 0 && !value_next){
+            if (!first) cson__buf_push(buf, ',');
+            if (pretty) cson__serialize_newline(buf, depth);
+        }
+        first = false;
+        value_next = is_key;
+        switch (tag){
+            case CsonTape_Int:{
+                int64_t value;
+                memcpy(&value, &tape->slots[++slot], sizeof(value));
+                cson__serialize_int(buf, value);
+            }break;
+            case CsonTape_Float:{
+                double value;
+                memcpy(&value, &tape->slots[++slot], sizeof(value));
+                cson__serialize_float(buf, value);
+            }break;
+            case CsonTape_True: cson__buf_append(buf, "true", 4); break;
+            case CsonTape_False: cson__buf_append(buf, "false", 5); break;
+            case CsonTape_Null: cson__buf_append(buf, "null", 4); break;
+            case CsonTape_String:{
+                cson__serialize_string(buf, cson__tape_str(tape, slot));
+                if (is_key){
+                    if (pretty) cson__buf_append(buf, ": ", 2);
+                    else cson__buf_push(buf, ':');
                 }
-                return true;
-            }
-            default: {
-                cson_error_unexpected(token.loc, token.type, CsonToken_String, CsonToken_MapClose);
-                return false;
+            }break;
+            case CsonTape_MapOpen:
+            case CsonTape_ArrayOpen:{
+                cson__buf_push(buf, (char) tag);
+                depth++;
+                if (tag == CsonTape_MapOpen) in_map[depth/64] |= (uint64_t) 1 << (depth%64);
+                else in_map[depth/64] &= ~((uint64_t) 1 << (depth%64));
+                first = true;
+            }break;
+            default:{
+                cson_error(CsonError_InvalidType, "Invalid tape slot: %zu", slot);
+                return CsonError_InvalidType;
             }
         }
-        size_t key_size = token.len+1;
-        char key_buffer[key_size];
-        cson_lex_extract(&token, key_buffer, key_size);
-        if (!cson_lex_expect(lexer, &token, CsonToken_MapSep)) return false;
-        Cson *cson = NULL;
-        if (!cson_lex_expect(lexer, &token, CSON_VALUE_TOKENS)) return false;
-        if (!cson__parse_value(&cson, lexer, &token)) return false;
-        cson_map_insert(map, cson_str_new(key_buffer), cson);
-        if (!cson_lex_expect(lexer, &token, CsonToken_Sep, CsonToken_MapClose)) return false;
-        switch (token.type){
-            case CsonToken_Sep:break;
-            case CsonToken_MapClose:return true;
-            default: {}
+    }
+    // keep the output terminated without counting the terminator
+    *cson__buf_reserve(buf, 1) = '\0';
+    return CsonError_Success;
+}
+
+/* Threads */
+
+#ifdef CSON_THREADS
+    #ifdef _WIN32
+        typedef HANDLE CsonThread;
+        typedef CRITICAL_SECTION CsonMutex;
+        typedef CONDITION_VARIABLE CsonCond;
+        #define CSON__THREAD_FN(name, arg) static DWORD WINAPI name(LPVOID arg)
+        #define CSON__THREAD_END return 0
+        #define cson__thread_start(thread, fn, arg) ((*(thread) = CreateThread(NULL, 0, (fn), (arg), 0, NULL)) != NULL)
+        #define cson__thread_join(thread) do{WaitForSingleObject((thread), INFINITE); CloseHandle(thread);}while(0)
+        #define cson__mutex_init(mutex) InitializeCriticalSection(mutex)
+        #define cson__mutex_destroy(mutex) DeleteCriticalSection(mutex)
+        #define cson__mutex_lock(mutex) EnterCriticalSection(mutex)
+        #define cson__mutex_unlock(mutex) LeaveCriticalSection(mutex)
+        #define cson__cond_init(cond) InitializeConditionVariable(cond)
+        #define cson__cond_destroy(cond) ((void) (cond))
+        #define cson__cond_wait(cond, mutex) SleepConditionVariableCS((cond), (mutex), INFINITE)
+        #define cson__cond_broadcast(cond) WakeAllConditionVariable(cond)
+    #else
+        typedef pthread_t CsonThread;
+        typedef pthread_mutex_t CsonMutex;
+        typedef pthread_cond_t CsonCond;
+        #define CSON__THREAD_FN(name, arg) static void* name(void *arg)
+        #define CSON__THREAD_END return NULL
+        #define cson__thread_start(thread, fn, arg) (pthread_create((thread), NULL, (fn), (arg)) == 0)
+        #define cson__thread_join(thread) pthread_join((thread), NULL)
+        #define cson__mutex_init(mutex) pthread_mutex_init((mutex), NULL)
+        #define cson__mutex_destroy(mutex) pthread_mutex_destroy(mutex)
+        #define cson__mutex_lock(mutex) pthread_mutex_lock(mutex)
+        #define cson__mutex_unlock(mutex) pthread_mutex_unlock(mutex)
+        #define cson__cond_init(cond) pthread_cond_init((cond), NULL)
+        #define cson__cond_destroy(cond) pthread_cond_destroy(cond)
+        #define cson__cond_wait(cond, mutex) pthread_cond_wait((cond), (mutex))
+        #define cson__cond_broadcast(cond) pthread_cond_broadcast(cond)
+    #endif
+
+static size_t cson__cpu_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t) info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0)? (size_t) count:1;
+#endif
+}
+#endif // CSON_THREADS
+
+/* Parallel parser implementation */
+
+typedef struct{
+    char *buffer;
+    size_t size;
+    CsonLoc loc; // location of buffer in the whole document
+    bool insitu;
+    bool quiet; // errors are not reported, the document is parsed again on failure
+    bool first; // the chunk starts with the root container
+    bool last; // the chunk ends with the root container
+    CsonType type;
+    CsonArena arena;
+    CsonArena *owner;
+    Cson *result;
+} CsonChunk;
+
+// finds separators of the root container close to even splits, returns the number of splits
+static size_t cson__parallel_splits(char *buffer, size_t buffer_size, size_t *splits, size_t count, CsonType *type)
+{
+    CsonLexer lexer = cson_lex_init(buffer, buffer_size, "");
+    if (!cson_lex_index(&lexer)) return 0;
+    size_t step = buffer_size / (count+1);
+    size_t target = step;
+    size_t found = 0;
+    size_t depth = 0;
+    size_t position;
+    // the index holds no positions inside of strings, so only quotes need to be skipped
+    while (found < count && (position = cson__lex_entry(&lexer)) < buffer_size){
+        lexer.structural_index++;
+        switch (buffer[position]){
+            case '[':
+            case '{':{
+                if (depth++ == 0) *type = (buffer[position] == '{')? Cson_Map:Cson_Array;
+            }break;
+            case ']':
+            case '}':{
+                if (depth-- <= 1) goto done;
+            }break;
+            case ',':{
+                if (depth == 1 && position >= target){
+                    splits[found++] = position;
+                    target = position + step;
+                }
+            }break;
+            default:{
+                if (depth == 0) goto done;
+            }
         }
     }
+done:
+    cson_lex_free(&lexer);
+    return found;
 }
 
-bool cson__parse_array(Cson *array, CsonLexer *lexer)
+static void cson__parse_chunk(CsonChunk *chunk)
 {
-    if (array == NULL || array->type != Cson_Array || lexer == NULL) return false;
+    bool muted = *cson__errors_muted();
+    *cson__errors_muted() = muted || chunk->quiet;
+    CsonLexer lexer = cson_lex_init(chunk->buffer, chunk->size, chunk->loc.filename);
+    lexer.loc = chunk->loc;
+    lexer.insitu = chunk->insitu;
+    (void) cson_lex_index(&lexer);
+    CsonGrammar grammar = {0};
+    CsonBuilder builder = {.arena=&chunk->arena, .owner=chunk->owner, .insitu=chunk->insitu};
     CsonToken token;
+    CsonEvent event;
+    if (!chunk->first){
+        // continue the root container right after one of its separators
+        cson_lex_set_token(&token, (chunk->type == Cson_Map)? CsonToken_MapOpen:CsonToken_ArrayOpen, chunk->buffer, chunk->buffer, lexer.loc);
+        (void) cson__grammar_step(&grammar, &token, &event);
+        cson__build(&builder, event, &token);
+        grammar.state = (chunk->type == Cson_Map)? CsonGrammar_Key:CsonGrammar_Value;
+    }
     while (true){
-        if (!cson_lex_expect(lexer, &token, CSON_VALUE_TOKENS, CsonToken_ArrayClose)) return false;
-        if (token.type == CsonToken_ArrayClose){
-            if (cson_len(array) > 0){
-                cson_error_unexpected(token.loc, token.type, CSON_VALUE_TOKENS);
-                return false;
+        token.type = CsonToken_Invalid;
+        if (!cson_lex_next(&lexer, &token)){
+            if (token.type != CsonToken_End) break;
+            bool complete = chunk->last? grammar.state == CsonGrammar_Done:(grammar.depth == 1 && grammar.state == CsonGrammar_SepOrClose);
+            if (complete){
+                // the root of a chunk that ends early is still open, its values wait on the value stack
+                if (!chunk->last) cson__build(&builder, (chunk->type == Cson_Map)? CsonEvent_EndMap:CsonEvent_EndArray, &token);
+                chunk->result = builder.root;
             }
-            return true;;
-        }
-        Cson *cson = NULL;
-        if (!cson__parse_value(&cson, lexer, &token)) return false;
-        cson_array_push(array, cson);
-        if (!cson_lex_expect(lexer, &token, CsonToken_Sep, CsonToken_ArrayClose)) return false;
-        switch (token.type){
-            case CsonToken_Sep: break;
-            case CsonToken_ArrayClose: return true;
-            default: {}
+            else{
+                cson_error(CsonError_EndOfBuffer, CSON_LOC_FMT": unexpected end of buffer", cson_loc_expand(cson_token_loc(&token)));
+            }
+            break;
         }
+        if (cson__grammar_step(&grammar, &token, &event) != CsonError_Success) break;
+        cson__build(&builder, event, &token);
     }
-    return false;
+    cson__grammar_free(&grammar);
+    cson__builder_free(&builder);
+    cson_lex_free(&lexer);
+    *cson__errors_muted() = muted;
 }
 
-bool cson__parse_value(Cson **cson, CsonLexer *lexer, CsonToken *token)
+#ifdef CSON_THREADS
+CSON__THREAD_FN(cson__chunk_thread, chunk)
 {
-    if (cson == NULL || lexer == NULL || token == NULL) return false;
-    size_t buff_size = token->len+1;
-    char buffer[buff_size];
-    cson_lex_extract(token, buffer, buff_size);
-    switch (token->type){
-        case CsonToken_ArrayOpen:{
-            Cson *array = cson_array_new();
-            if (!cson__parse_array(array, lexer)) return false;
-            *cson = array;
-        }break;
-        case CsonToken_MapOpen:{
-            Cson *map = cson_map_new();
-            if (!cson__parse_map(map, lexer)) return false;
-            *cson = map;
-        }break;
-        case CsonToken_Int:{
-            *cson = cson_new_int(atoll(buffer));
-        }break;
-        case CsonToken_Float:{
-            *cson = cson_new_float(atof(buffer));
-        }break;
-        case CsonToken_String:{
-            *cson = cson_new_cstring(buffer);
-        }break;
-        case CsonToken_True:{
-            *cson = cson_new_bool(true);
-        }break;
-        case CsonToken_False:{
-            *cson = cson_new_bool(false);
-        }break;
-        case CsonToken_Null:{
-            *cson = cson_new_null();
-        }break;
-        default: {}
+    cson__parse_chunk(chunk);
+    CSON__THREAD_END;
+}
+#endif // CSON_THREADS
+
+Cson* cson__parse_parallel(CsonArena *arena, char *buffer, size_t buffer_size, char *filename, bool insitu, size_t threads)
+{
+    if (arena == NULL || buffer == NULL || buffer_size == 0) return NULL;
+#ifdef CSON_THREADS
+    if (threads == 0) threads = cson__cpu_count();
+#else
+    threads = 1;
+#endif // CSON_THREADS
+    size_t *splits = NULL;
+    size_t split_count = 0;
+    CsonType type = Cson_Null;
+    if (threads > 1 && buffer_size >= CSON_PARALLEL_MIN_SIZE){
+        splits = malloc((threads-1)*sizeof(*splits));
+        cson_assert_alloc(splits);
+        split_count = cson__parallel_splits(buffer, buffer_size, splits, threads-1, &type);
     }
-    return true;
+    if (split_count == 0){
+        free(splits);
+        return cson__parse(arena, buffer, buffer_size, filename, insitu);
+    }
+    size_t chunk_count = split_count+1;
+    CsonChunk *chunks = calloc(chunk_count, sizeof(*chunks));
+    cson_assert_alloc(chunks);
+    // an in-situ buffer cannot be parsed again, so only then do the chunks report their errors
+    CsonLoc loc = {.filename=filename, .row=1, .column=1};
+    size_t counted = 0;
+    for (size_t i=0; i<chunk_count; ++i){
+        size_t start = (i == 0)? 0:splits[i-1]+1;
+        size_t end = (i == split_count)? buffer_size:splits[i];
+        cson__advance_loc(&loc, buffer + counted, buffer + start);
+        counted = start;
+        chunks[i] = (CsonChunk) {.buffer=buffer+start, .size=end-start, .loc=loc, .insitu=insitu, .quiet=!insitu, .first=(i == 0), .last=(i == split_count), .type=type, .owner=arena};
+    }
+    free(splits);
+#ifdef CSON_THREADS
+    // the calling thread parses the first chunk itself
+    CsonThread *workers = malloc(chunk_count*sizeof(*workers));
+    bool *started = calloc(chunk_count, sizeof(*started));
+    cson_assert_alloc(workers);
+    cson_assert_alloc(started);
+    for (size_t i=1; i<chunk_count; ++i){
+        started[i] = cson__thread_start(&workers[i], cson__chunk_thread, &chunks[i]);
+    }
+    cson__parse_chunk(&chunks[0]);
+    for (size_t i=1; i<chunk_count; ++i){
+        if (started[i]) cson__thread_join(workers[i]);
+        else cson__parse_chunk(&chunks[i]);
+    }
+    free(workers);
+    free(started);
+#else
+    for (size_t i=0; i<chunk_count; ++i) cson__parse_chunk(&chunks[i]);
+#endif // CSON_THREADS
+    bool success = true;
+    size_t total = 0;
+    for (size_t i=0; i<chunk_count; ++i){
+        if (chunks[i].result == NULL) success = false;
+        else total += cson_len(chunks[i].result);
+    }
+    Cson *root = NULL;
+    if (success){
+        // stitch the chunks together in the target arena
+        if (type == Cson_Array){
+            root = cson__array_new_sized(arena, total);
+            CsonArray *array = root->value.array;
+            for (size_t i=0; i<chunk_count; ++i){
+                CsonArray *part = chunks[i].result->value.array;
+                // the builder gives every array exactly its size, so the parts are contiguous
+                if (part->size != 0) memcpy(array->head + array->size, part->head, part->size*sizeof(Cson));
+                array->size += part->size;
+            }
+        }
+        else{
+            root = cson__map_new(arena);
+            for (size_t i=0; i<chunk_count; ++i){
+                CsonMap *part = chunks[i].result->value.map;
+                size_t index = 0;
+                CsonMapItem *item;
+                while ((item = cson__map_next(part, &index)) != NULL){
+                    cson__map_insert(root, item->key, item->hash, item->value);
+                }
+            }
+        }
+    }
+    for (size_t i=0; i<chunk_count; ++i){
+        if (success) cson__arena_adopt(arena, &chunks[i].arena);
+        else cson__free(&chunks[i].arena);
+    }
+    free(chunks);
+    // an in-situ buffer has already been modified, otherwise the serial parser reports the exact error location
+    if (!success && !insitu) return cson__parse(arena, buffer, buffer_size, filename, insitu);
+    return root;
 }
 
-#define cson_parse(buffer, buffer_size) cson_parse_buffer(buffer, buffer_size, "")
+Cson* cson_parse_parallel(char *buffer, size_t buffer_size, char *filename, size_t threads)
+{
+    return cson__parse_parallel(cson_current_arena, buffer, buffer_size, filename, false, threads);
+}
 
-Cson* cson_parse_buffer(char *buffer, size_t buffer_size, char *filename)
+Cson* cson_read_parallel(char *filename, size_t threads)
 {
-    if (buffer == NULL || buffer_size == 0) return NULL;
-    CsonLexer lexer = cson_lex_init(buffer, buffer_size, filename);
-    CsonToken token;
-    if (!cson_lex_next(&lexer, &token)){
-        if (token.type == CsonToken_End){
-            cson_error(CsonError_EndOfBuffer, "file is empty: \"%s\"", filename);
+    CsonArena *arena = cson_current_arena;
+    size_t size;
+    char *content = cson__map_file(arena, filename, &size);
+    if (content == NULL) return NULL;
+    return cson__parse_parallel(arena, content, size, filename, true, threads);
+}
+
+/* Line-delimited parser implementation */
+
+typedef enum{
+    CsonLineSlot_Free,
+    CsonLineSlot_Busy,
+    CsonLineSlot_Done,
+} CsonLineSlotState;
+
+typedef struct{
+    Cson *value;
+    size_t line;
+} CsonLineRecord;
+
+typedef struct{
+    CsonArena arena; // reset after every batch
+    CsonLineRecord *records;
+    size_t count;
+    size_t capacity;
+    char *start;
+    char *end;
+    size_t line; // line number of start, 0 until the batches before it are counted
+    size_t lines; // newlines in the batch
+    bool counted;
+    size_t batch;
+    CsonLineSlotState state;
+} CsonLineSlot;
+
+typedef struct{
+    char *cursor; // start of the next batch
+    char *end;
+    size_t line; // line number of the first batch that is not numbered yet
+    size_t numbered; // number of batches with a known line number
+    size_t next; // number of the next batch
+    size_t delivered;
+    CsonLineSlot *slots;
+    size_t slot_count;
+    char *filename;
+    bool insitu;
+    bool stop;
+#ifdef CSON_THREADS
+    CsonMutex mutex;
+    CsonCond cond;
+#endif // CSON_THREADS
+} CsonLinePool;
+
+// assigns the next batch to a free slot, returns NULL if there is none.
+// only the end of the batch is searched here, its lines are counted by the parsing thread
+static CsonLineSlot* cson__lines_claim(CsonLinePool *pool)
+{
+    if (pool->stop || pool->cursor >= pool->end) return NULL;
+    CsonLineSlot *slot = NULL;
+    for (size_t i=0; i<pool->slot_count && slot == NULL; ++i){
+        if (pool->slots[i].state == CsonLineSlot_Free) slot = &pool->slots[i];
+    }
+    if (slot == NULL) return NULL;
+    char *end = pool->end;
+    if ((size_t) (pool->end - pool->cursor) > CSON_LINES_BATCH){
+        char *eol = memchr(pool->cursor + CSON_LINES_BATCH, '\n', pool->end - pool->cursor - CSON_LINES_BATCH);
+        if (eol != NULL) end = eol+1;
+    }
+    slot->start = pool->cursor;
+    slot->end = end;
+    slot->line = 0;
+    slot->counted = false;
+    slot->batch = pool->next++;
+    slot->state = CsonLineSlot_Busy;
+    pool->cursor = end;
+    return slot;
+}
+
+// records the newlines of slot, then numbers every batch whose predecessors have all been counted
+static void cson__lines_number(CsonLinePool *pool, CsonLineSlot *slot, size_t lines)
+{
+    slot->lines = lines;
+    slot->counted = true;
+    bool progress = true;
+    while (progress){
+        progress = false;
+        for (size_t i=0; i<pool->slot_count; ++i){
+            CsonLineSlot *next = &pool->slots[i];
+            if (next->state != CsonLineSlot_Busy || !next->counted || next->batch != pool->numbered) continue;
+            next->line = pool->line;
+            pool->line += next->lines;
+            pool->numbered++;
+            progress = true;
         }
-        return NULL;
     }
-    Cson *cson = NULL;
-    switch(token.type){
-        case CsonToken_ArrayOpen:{
-            Cson *array = cson_array_new();
-            if (cson__parse_array(array, &lexer)){
-                cson = array;
-            }
-        }break;
-        case CsonToken_MapOpen:{
-            Cson *map = cson_map_new();
-            if (cson__parse_map(map, &lexer)){
-                cson = map;
+}
+
+static void cson__lines_parse(CsonLinePool *pool, CsonLineSlot *slot)
+{
+    slot->count = 0;
+    size_t line = slot->line;
+    for (char *start = slot->start; start < slot->end; ++line){
+        char *eol = memchr(start, '\n', slot->end - start);
+        if (eol == NULL) eol = slot->end;
+        char *p = start;
+        while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+        // blank lines are skipped
+        if (p < eol){
+            if (slot->count >= slot->capacity){
+                slot->capacity = (slot->capacity == 0)? 256:slot->capacity*2;
+                slot->records = realloc(slot->records, slot->capacity*sizeof(*slot->records));
+                cson_assert_alloc(slot->records);
             }
-        }break;
-        default:{
-            cson_error(CsonError_UnexpectedToken, CSON_LOC_FMT": json object may only start with [%s, %s] and not [%s]", cson_loc_expand(token.loc), CsonTokenTypeNames[CsonToken_ArrayOpen], CsonTokenTypeNames[CsonToken_MapOpen], CsonTokenTypeNames[token.type]);
-            return NULL;
+            Cson *value = cson__parse_loc(&slot->arena, start, eol-start, (CsonLoc) {.filename=pool->filename, .row=line, .column=1}, pool->insitu);
+            slot->records[slot->count++] = (CsonLineRecord) {.value=value, .line=line};
         }
+        start = eol+1;
     }
-    if (cson != NULL && !cson_lex_expect(&lexer, &token, CsonToken_End)){
-        cson_error(CsonError_UnexpectedToken, "json object may not have trailing values after closing of parent %s!", CsonTypeStrings[cson->type]);
-        return NULL;
+}
+
+static bool cson__lines_deliver(CsonLineSlot *slot, CsonLineFn callback, void *user)
+{
+    bool proceed = true;
+    for (size_t i=0; i<slot->count && proceed; ++i){
+        proceed = callback(slot->records[i].value, slot->records[i].line, user);
     }
-    return cson;
+    cson_arena_reset(&slot->arena);
+    return proceed;
 }
 
-size_t cson__read_file(FILE *file, char *buffer, size_t buffer_size) {
-    size_t total = 0;
-    int prev = 0;
+#ifdef CSON_THREADS
+CSON__THREAD_FN(cson__lines_worker, arg)
+{
+    CsonLinePool *pool = arg;
+    cson__mutex_lock(&pool->mutex);
+    while (!pool->stop && pool->cursor < pool->end){
+        CsonLineSlot *slot = cson__lines_claim(pool);
+        if (slot == NULL){
+            cson__cond_wait(&pool->cond, &pool->mutex);
+            continue;
+        }
+        cson__mutex_unlock(&pool->mutex);
+        size_t lines = cson__count_newlines(slot->start, slot->end);
+        cson__mutex_lock(&pool->mutex);
+        cson__lines_number(pool, slot, lines);
+        cson__cond_broadcast(&pool->cond);
+        // the batches before this one are being counted right now, so the wait is short
+        while (slot->line == 0) cson__cond_wait(&pool->cond, &pool->mutex);
+        cson__mutex_unlock(&pool->mutex);
+        cson__lines_parse(pool, slot);
+        cson__mutex_lock(&pool->mutex);
+        slot->state = CsonLineSlot_Done;
+        cson__cond_broadcast(&pool->cond);
+    }
+    cson__mutex_unlock(&pool->mutex);
+    CSON__THREAD_END;
+}
 
-    while (total < buffer_size - 1) {
-        int c = fgetc(file);
-        if (c == EOF) break;
+// delivers the parsed batches on the calling thread
+static CsonError cson__lines_collect(CsonLinePool *pool, CsonLineFn callback, void *user, bool ordered)
+{
+    CsonError result = CsonError_Success;
+    cson__mutex_lock(&pool->mutex);
+    while (true){
+        CsonLineSlot *slot = NULL;
+        bool pending = false;
+        for (size_t i=0; i<pool->slot_count; ++i){
+            CsonLineSlot *candidate = &pool->slots[i];
+            if (candidate->state == CsonLineSlot_Free) continue;
+            pending = true;
+            if (candidate->state == CsonLineSlot_Done && (!ordered || candidate->batch == pool->delivered)){
+                slot = candidate;
+                break;
+            }
+        }
+        if (slot == NULL){
+            if (!pending && pool->cursor >= pool->end) break;
+            cson__cond_wait(&pool->cond, &pool->mutex);
+            continue;
+        }
+        cson__mutex_unlock(&pool->mutex);
+        bool proceed = cson__lines_deliver(slot, callback, user);
+        cson__mutex_lock(&pool->mutex);
+        slot->state = CsonLineSlot_Free;
+        pool->delivered++;
+        if (!proceed){
+            pool->stop = true;
+            result = CsonError_Aborted;
+        }
+        cson__cond_broadcast(&pool->cond);
+        if (!proceed) break;
+    }
+    cson__mutex_unlock(&pool->mutex);
+    return result;
+}
+#endif // CSON_THREADS
 
-        if (prev == '\r' && c == '\n') {
-            buffer[total - 1] = '\n'; // Replace \r with \n
-        } else {
-            buffer[total++] = (char)c;
+static CsonError cson__parse_lines(char *buffer, size_t buffer_size, char *filename, CsonLineFn callback, void *user, size_t threads, int flags, bool insitu)
+{
+    if (buffer == NULL || callback == NULL) return CsonError_InvalidParam;
+    CsonLinePool pool = {.cursor=buffer, .end=buffer+buffer_size, .line=1, .filename=filename, .insitu=insitu};
+    CsonError result = CsonError_Success;
+#ifdef CSON_THREADS
+    if (threads == 0) threads = cson__cpu_count();
+    if (threads > 1 && buffer_size > CSON_LINES_BATCH){
+        // two slots per worker keep the workers busy while batches are delivered
+        pool.slot_count = 2*threads;
+        pool.slots = calloc(pool.slot_count, sizeof(*pool.slots));
+        CsonThread *workers = malloc(threads*sizeof(*workers));
+        cson_assert_alloc(pool.slots);
+        cson_assert_alloc(workers);
+        cson__mutex_init(&pool.mutex);
+        cson__cond_init(&pool.cond);
+        size_t started = 0;
+        while (started < threads && cson__thread_start(&workers[started], cson__lines_worker, &pool)) started++;
+        if (started > 0) result = cson__lines_collect(&pool, callback, user, !(flags & CsonLines_Unordered));
+        for (size_t i=0; i<started; ++i){
+            cson__thread_join(workers[i]);
+        }
+        cson__cond_destroy(&pool.cond);
+        cson__mutex_destroy(&pool.mutex);
+        free(workers);
+        if (started > 0) goto done;
+        // no thread could be started, the batches are parsed below
+        pool.slot_count = 1;
+    }
+#else
+    (void) threads;
+    (void) flags;
+#endif // CSON_THREADS
+    if (pool.slots == NULL){
+        pool.slot_count = 1;
+        pool.slots = calloc(1, sizeof(*pool.slots));
+        cson_assert_alloc(pool.slots);
+    }
+    CsonLineSlot *slot;
+    while ((slot = cson__lines_claim(&pool)) != NULL){
+        cson__lines_number(&pool, slot, cson__count_newlines(slot->start, slot->end));
+        cson__lines_parse(&pool, slot);
+        slot->state = CsonLineSlot_Free;
+        if (!cson__lines_deliver(slot, callback, user)){
+            result = CsonError_Aborted;
+            break;
         }
-        prev = c;
     }
+#ifdef CSON_THREADS
+done:
+#endif // CSON_THREADS
+    for (size_t i=0; i<pool.slot_count; ++i){
+        cson__free(&pool.slots[i].arena);
+        free(pool.slots[i].records);
+    }
+    free(pool.slots);
+    return result;
+}
 
-    buffer[total] = '\0';
-    return total;
+CsonError cson_parse_lines(char *buffer, size_t buffer_size, char *filename, CsonLineFn callback, void *user, size_t threads, int flags)
+{
+    return cson__parse_lines(buffer, buffer_size, filename, callback, user, threads, flags, false);
 }
 
-Cson* cson_read(char *filename){
-    FILE *file = fopen(filename, "r");
-    if (file == NULL){
-        cson_error(CsonError_FileNotFound, "Could not open file: \"%s\"", filename);
-        return NULL;
+CsonError cson_read_lines(char *filename, CsonLineFn callback, void *user, size_t threads, int flags)
+{
+    CsonArena arena = {0};
+    size_t size;
+    char *content = cson__map_file(&arena, filename, &size);
+    if (content == NULL) return CsonError_FileNotFound;
+    CsonError result = cson__parse_lines(content, size, filename, callback, user, threads, flags, true);
+    cson__free(&arena);
+    return result;
+}
+
+/* SAX implementation */
+
+static char* cson__sax_scratch(char **scratch, size_t *capacity, size_t size)
+{
+    if (size > *capacity){
+        size_t new_capacity = (*capacity == 0)? 256:*capacity;
+        while (new_capacity < size) new_capacity *= 2;
+        char *temp = realloc(*scratch, new_capacity);
+        cson_assert_alloc(temp);
+        *scratch = temp;
+        *capacity = new_capacity;
     }
-    uint64_t file_size = cson_file_size(filename);
-    char *file_content = (char*) calloc(file_size+1, sizeof(*file_content));
-    cson_assert_alloc(file_content);
-    (void) cson__read_file(file, file_content, file_size+1);
-    fclose(file);
-    Cson *cson = cson_parse_buffer(file_content, file_size, filename);
-    free(file_content);
-    return cson;
+    return *scratch;
+}
+
+#define cson__sax_emit(sax, callback, ...) ((sax)->callback == NULL || (sax)->callback(__VA_ARGS__))
+
+static bool cson__sax_dispatch(CsonSax *sax, void *user, CsonEvent event, CsonToken *token, char **scratch, size_t *scratch_capacity)
+{
+    switch (event){
+        case CsonEvent_BeginMap: return cson__sax_emit(sax, begin_map, user);
+        case CsonEvent_EndMap: return cson__sax_emit(sax, end_map, user);
+        case CsonEvent_BeginArray: return cson__sax_emit(sax, begin_array, user);
+        case CsonEvent_EndArray: return cson__sax_emit(sax, end_array, user);
+        case CsonEvent_Key:
+        case CsonEvent_Value:{
+            char *buffer = NULL;
+            size_t len = 0;
+            if (token->type == CsonToken_String){
+                buffer = cson__sax_scratch(scratch, scratch_capacity, token->len+1);
+                len = cson_lex_unescape(buffer, token->t_start, token->len);
+                buffer[len] = '\0';
+            }
+            if (event == CsonEvent_Key) return cson__sax_emit(sax, map_key, user, ((CsonStr) {.value=buffer, .len=len}));
+            switch (token->type){
+                case CsonToken_Int: return cson__sax_emit(sax, integer, user, token->number.integer);
+                case CsonToken_Float: return cson__sax_emit(sax, floating, user, token->number.floating);
+                case CsonToken_String: return cson__sax_emit(sax, string, user, ((CsonStr) {.value=buffer, .len=len}));
+                case CsonToken_True: return cson__sax_emit(sax, boolean, user, true);
+                case CsonToken_False: return cson__sax_emit(sax, boolean, user, false);
+                default: return cson__sax_emit(sax, null, user);
+            }
+        }
+        default: return true;
+    }
+}
+
+static CsonError cson__sax_run(CsonLexer *lexer, CsonSax *sax, void *user)
+{
+    CsonGrammar grammar = {0};
+    char *scratch = NULL;
+    size_t scratch_capacity = 0;
+    CsonError result = CsonError_Success;
+    CsonToken token;
+    CsonEvent event;
+    while (true){
+        token.type = CsonToken_Invalid;
+        if (!cson_lex_next(lexer, &token)){
+            result = (token.type == CsonToken_End)? cson__grammar_end(&grammar, &token):CsonError_UnexpectedToken;
+            break;
+        }
+        if ((result = cson__grammar_step(&grammar, &token, &event)) != CsonError_Success) break;
+        if (!cson__sax_dispatch(sax, user, event, &token, &scratch, &scratch_capacity)){
+            result = CsonError_Aborted;
+            break;
+        }
+    }
+    cson__grammar_free(&grammar);
+    free(scratch);
+    return result;
+}
+
+CsonError cson_sax_parse(char *buffer, size_t buffer_size, char *filename, CsonSax *sax, void *user)
+{
+    if (buffer == NULL || buffer_size == 0 || sax == NULL) return CsonError_InvalidParam;
+    CsonLexer lexer = cson_lex_init(buffer, buffer_size, filename);
+    (void) cson_lex_index(&lexer);
+    CsonError result = cson__sax_run(&lexer, sax, user);
+    cson_lex_free(&lexer);
+    return result;
+}
+
+CsonError cson_sax_read(char *filename, CsonSax *sax, void *user)
+{
+    CsonArena arena = {0};
+    size_t size;
+    char *content = cson__map_file(&arena, filename, &size);
+    if (content == NULL) return CsonError_FileNotFound;
+    CsonError result = cson_sax_parse(content, size, filename, sax, user);
+    cson__free(&arena);
+    return result;
 }
 #endif // CSON_IMPLEMENTATION
@@ -13,7 +13,7 @@ int main(void)
     cson_print(map);
     int64_t manager_id;
     if (!cson_get_int(&manager_id, cson, key("company"), key("employees"), index(1), key("manager"), key("id"))) return 1;
-    printf("The id of the second employee's manager is: %I64d\n", manager_id);
+    printf("The id of the second employee's manager is: %" PRId64 "\n", manager_id);
     cson_write(cson, "out.json");
     cson_free();
     return 0;
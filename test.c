@@ -0,0 +1,174 @@
+#include <stdio.h>
+#define CSON_IMPLEMENTATION
+#include "cson.h"
+
+// differential tests: every path has to agree with the byte-wise lexer and cson_parse_buffer
+
+static size_t failures = 0;
+
+#define check(cond, name, ...) do{if (!(cond)){failures++; fprintf(stderr, "FAIL %s: ", (name)); fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n");}}while(0)
+
+typedef struct{
+    char *data;
+    size_t size;
+} Input;
+
+// the byte-wise lexer reads the byte after the buffer, so inputs are '\0' terminated
+static Input input_new(CsonBuf *text)
+{
+    Input input = {.data=malloc(text->size+1), .size=text->size};
+    cson_assert_alloc(input.data);
+    memcpy(input.data, text->data, text->size);
+    input.data[text->size] = '\0';
+    text->size = 0;
+    return input;
+}
+
+static void append(CsonBuf *buf, const char *text)
+{
+    size_t len = strlen(text);
+    if (buf->size + len + 1 > buf->capacity){
+        buf->capacity = (buf->capacity + len + 1)*2;
+        buf->data = realloc(buf->data, buf->capacity);
+        cson_assert_alloc(buf->data);
+    }
+    memcpy(buf->data + buf->size, text, len+1);
+    buf->size += len;
+}
+
+static bool same_token(CsonToken *a, CsonToken *b, bool locations)
+{
+    if (a->type != b->type || a->t_start != b->t_start || a->t_end != b->t_end) return false;
+    if ((a->type == CsonToken_Int || a->type == CsonToken_Float) && memcmp(&a->number, &b->number, sizeof(a->number)) != 0) return false;
+    if (!locations) return true;
+    CsonLoc la = cson_token_loc(a), lb = cson_token_loc(b);
+    return la.row == lb.row && la.column == lb.column;
+}
+
+static void test_lexer(char *name, Input input)
+{
+    CsonLexer bytewise = cson_lex_init(input.data, input.size, name);
+    CsonLexer indexed = cson_lex_init(input.data, input.size, name);
+    check(cson_lex_index(&indexed), name, "could not index");
+    // an indexed location is counted from the start of the buffer, so only small inputs compare every one
+    bool locations = input.size < CSON_INDEX_WINDOW;
+    size_t count = 0;
+    while (true){
+        CsonToken a = {0}, b = {0};
+        bool more_a = cson_lex_next(&bytewise, &a);
+        bool more_b = cson_lex_next(&indexed, &b);
+        if (more_a != more_b || !same_token(&a, &b, locations)){
+            CsonLoc la = cson_token_loc(&a), lb = cson_token_loc(&b);
+            check(false, name, "token %zu differs: %s at %zu:%zu, indexed %s at %zu:%zu", count,
+                  CsonTokenTypeNames[a.type], la.row, la.column, CsonTokenTypeNames[b.type], lb.row, lb.column);
+            break;
+        }
+        count++;
+        if (!more_a) break;
+    }
+    cson_lex_free(&indexed);
+}
+
+static bool serialize(Cson *cson, CsonBuf *out)
+{
+    out->size = 0;
+    return cson != NULL && cson_serialize(cson, out, CsonSerialize_Compact) == CsonError_Success;
+}
+
+static void test_round_trips(char *name, Input input)
+{
+    CsonBuf expected = {0}, actual = {0}, binary = {0};
+    char *copy = malloc(input.size);
+    cson_assert_alloc(copy);
+    memcpy(copy, input.data, input.size);
+    if (!serialize(cson_parse_buffer(copy, input.size, name), &expected)){
+        check(false, name, "cson_parse_buffer failed");
+        free(copy);
+        return;
+    }
+    // chunks may end anywhere, even inside of a token
+    size_t chunk_sizes[] = {1, 3, 64, 4096};
+    for (size_t i=0; i<cson_arr_len(chunk_sizes); ++i){
+        CsonParser *parser = cson_parser_new(name);
+        CsonError error = CsonError_Success;
+        for (size_t pos=0; pos<input.size && error == CsonError_Success; pos+=chunk_sizes[i]){
+            size_t len = (input.size - pos < chunk_sizes[i])? input.size - pos:chunk_sizes[i];
+            error = cson_parser_feed(parser, input.data + pos, len);
+        }
+        bool ok = serialize(cson_parser_finish(parser), &actual);
+        check(ok && actual.size == expected.size && memcmp(actual.data, expected.data, expected.size) == 0, name, "cson_parser_feed with chunks of %zu differs", chunk_sizes[i]);
+        cson_parser_free(parser);
+    }
+    CsonTape tape = {0};
+    memcpy(copy, input.data, input.size);
+    bool ok = cson_tape_parse(&tape, copy, input.size, name);
+    actual.size = 0;
+    ok = ok && cson_tape_serialize(cson_tape_root(&tape), &actual, CsonSerialize_Compact) == CsonError_Success;
+    check(ok && actual.size == expected.size && memcmp(actual.data, expected.data, expected.size) == 0, name, "tape differs");
+    cson_tape_free(&tape);
+
+    memcpy(copy, input.data, input.size);
+    ok = cson_serialize_binary(cson_parse_buffer(copy, input.size, name), &binary) == CsonError_Success;
+    ok = ok && serialize(cson_parse_binary(binary.data, binary.size, name), &actual);
+    check(ok && actual.size == expected.size && memcmp(actual.data, expected.data, expected.size) == 0, name, "CBOR round trip differs");
+
+    cson_buf_free(&expected);
+    cson_buf_free(&actual);
+    cson_buf_free(&binary);
+    free(copy);
+    cson_free();
+}
+
+int main(void)
+{
+    CsonBuf text = {0};
+    char piece[256];
+
+    // runs of backslashes before a quote, with the quote on both sides of a 64 byte block edge
+    for (size_t backslashes=1; backslashes<=5; ++backslashes){
+        for (size_t pad=0; pad<140; ++pad){
+            append(&text, "[\"");
+            for (size_t i=0; i<pad; ++i) append(&text, "a");
+            for (size_t i=0; i<backslashes; ++i) append(&text, "\\");
+            // an odd run escapes the quote, the string goes on
+            append(&text, (backslashes % 2 == 1)? "\"x\", 1]":"\", 1]");
+            Input input = input_new(&text);
+            snprintf(piece, sizeof(piece), "backslashes %zu, pad %zu", backslashes, pad);
+            test_lexer(piece, input);
+            test_round_trips(piece, input);
+            free(input.data);
+        }
+    }
+
+    // documents of several index windows, shifted so tokens straddle the window edges
+    for (size_t shift=0; shift<12; ++shift){
+        append(&text, "[");
+        for (size_t i=0; i<shift; ++i) append(&text, " ");
+        for (size_t i=0; text.size < 3*CSON_INDEX_WINDOW; ++i){
+            snprintf(piece, sizeof(piece), "%s{\"id\":%zu,\"ratio\":-%zu.%03zue-2,\"name\":\"item \\\"%zu\\\"\\n\",\"ok\":%s,\"none\":null,\"big\":12345678901234567890}",
+                     (i == 0)? "":",", i, i, i % 1000, i, (i % 3 == 0)? "true":"false");
+            append(&text, piece);
+        }
+        append(&text, "]");
+        Input input = input_new(&text);
+        snprintf(piece, sizeof(piece), "windows, shift %zu", shift);
+        test_lexer(piece, input);
+        test_round_trips(piece, input);
+        free(input.data);
+    }
+
+    // CRLF line endings, the rows and columns of both lexers have to agree
+    append(&text, "{\r\n  \"a\": [1, 2.5,\r\n\t-3],\r\n  \"b\" : {\"c\": \"d\\r\\n\"},\r\n\r\n  \"e\": true\r\n}\r\n");
+    Input input = input_new(&text);
+    test_lexer("crlf", input);
+    test_round_trips("crlf", input);
+    free(input.data);
+
+    cson_buf_free(&text);
+    if (failures != 0){
+        fprintf(stderr, "%zu checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}